@@ -0,0 +1,1368 @@
+/* 
+
+  GPL LICENSE SUMMARY
+
+  Copyright(c) Pat Brouillette. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify 
+  it under the terms of version 2 of the GNU General Public License as
+  published by the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful, but 
+  WITHOUT ANY WARRANTY; without even the implied warranty of 
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU 
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License 
+  along with this program; if not, write to the Free Software 
+  Foundation, Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+  The full GNU General Public License is included in this distribution 
+  in the file called LICENSE.GPL.
+
+  Contact Information:
+    Pat Brouillette  pfrench@acm.org
+
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#ifdef GUI_DEBUGGER
+#include <unistd.h>
+#include <fcntl.h>
+#include <assert.h>
+#endif
+
+#include "spdifDecoder.h"
+#include "wavhdr.h"
+
+/*
+ *  The "C" API wraps a decoder that keeps 16-bit widths and computes its
+ *  thresholds over two subframes worth of edges.
+ */
+#define SPDIF_ANALYZER_WINDOW_EDGES (SPDIF_ANALYZER_SAMPLE_EDGES<<1)
+
+/* raw samples are turned into edges this many words at a time */
+#define SPDIF_SAMPLE_BATCH_WORDS    64
+
+/* decoder sink that hands everything to the "C" callbacks, or subframes to a buffer when one is set */
+struct SpdifCallbackSink
+{
+    struct SpdifBitstreamCallbacks  cb;
+    struct SpdifRelockCallbacks     rcb;
+    struct SpdifSubframeWriter      out;
+
+    void sample_callback( uint64_t t, uint64_t tend, enum SpdifFrameType ft, uint32_t aud_sample )
+    {
+        if ( NULL != out.buf )
+            out.sample_callback( t, tend, ft, aud_sample );
+        else
+            (*cb.cb_sample)( cb.userdata, t, tend, ft, aud_sample );
+    }
+
+    void status_callback( uint64_t t, uint64_t tend, struct SpdifChannelStatus *status )
+    {
+        out.status_callback( t, tend, status );
+        (*cb.cb_status)( cb.userdata, t, tend, status );
+    }
+
+    void relock_callback( uint64_t t, uint64_t tend, uint32_t nedges )
+    {
+        out.relock_callback( t, tend, nedges );
+
+        if ( NULL != rcb.cb_relock )
+            (*rcb.cb_relock)( cb.userdata, t, tend, nedges );
+    }
+
+    void suspect_callback( uint64_t t, uint64_t tend )
+    {
+        out.suspect_callback( t, tend );
+
+        if ( NULL != rcb.cb_suspect )
+            (*rcb.cb_suspect)( cb.userdata, t, tend );
+    }
+};
+
+struct SpdifBitstreamAnalyzer
+{
+    struct SpdifCallbackSink    sink;
+    SpdifDecoder<uint16_t,SPDIF_ANALYZER_WINDOW_EDGES,SpdifCallbackSink>    dec;
+    struct SpdifBlockIndex     *index;
+    struct SpdifBitEdges        bits;   /* AddSamples() */
+    struct SpdifTraceWriter    *trace;
+
+    FILE                   *fout;  /* RAW output */
+    struct SpdifWavWriter  *wav;   /* WAV output */
+};
+
+#ifdef SELF_TEST
+static struct SpdifBitstreamAnalyzer   s_sba;
+#endif
+
+/* -------------------------------------------------------------------------------------------- */
+/* WAV output */
+/* -------------------------------------------------------------------------------------------- */
+
+/* output buffer, written out whole so every write lands on a multiple of it in the file */
+#define SPDIF_WAV_BUFFER_BYTES  (1<<20)
+
+#define _WH_CHANNELS            2
+
+/* biggest a RIFF size field holds, past it the file is RF64 */
+#define _WH_RIFF_MAX            0xffffffffULL
+
+struct SpdifWavWriter
+{
+    FILE            *f;
+    uint32_t         rate;
+    unsigned int     bits;          /* SPDIF_WAV_BITS_x */
+    unsigned int     bytes;         /* per channel */
+    int              shift;         /* raw subframe to the top of the sample */
+    uint32_t         mask;
+    uint64_t         nframes;
+    int              half;          /* a left channel is written, waiting for its right */
+    uint32_t         left;          /* and that left */
+    int              err;
+    size_t           fill;
+    unsigned char    buf[SPDIF_WAV_BUFFER_BYTES];
+};
+
+/* KSDATAFORMAT_SUBTYPE_PCM, 00000001-0000-0010-8000-00aa00389b71 */
+static const unsigned char s_wh_pcm[16] =
+{
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+    0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71
+};
+
+void wh_Init(
+    struct WAVHeader    *wh,
+    uint64_t             nframes,
+    uint32_t             rate,
+    unsigned int         bits )
+{
+    uint32_t    bytes = (bits > 16) ? 3 : 2;
+    uint64_t    dlen = nframes * (bytes * _WH_CHANNELS);
+    uint64_t    len = dlen + sizeof(struct WAVHeader) - 8;
+
+    memset( wh, 0, sizeof(*wh) );
+
+    if ( len <= _WH_RIFF_MAX )
+    {
+        wh->wh_RIFF[0] = 'R';   wh->wh_RIFF[1] = 'I';
+        wh->wh_RIFF[2] = 'F';   wh->wh_RIFF[3] = 'F';
+
+        wh->wh_len = (uint32_t) len;
+
+        /* room for the ds64 chunk, should the file be rewritten as RF64 */
+        wh->wh_ds64[0] = 'J';   wh->wh_ds64[1] = 'U';
+        wh->wh_ds64[2] = 'N';   wh->wh_ds64[3] = 'K';
+
+        wh->wh_dlen = (uint32_t) dlen;
+    }
+    else
+    {
+        wh->wh_RIFF[0] = 'R';   wh->wh_RIFF[1] = 'F';
+        wh->wh_RIFF[2] = '6';   wh->wh_RIFF[3] = '4';
+
+        wh->wh_len = (uint32_t) _WH_RIFF_MAX;
+
+        wh->wh_ds64[0] = 'd';   wh->wh_ds64[1] = 's';
+        wh->wh_ds64[2] = '6';   wh->wh_ds64[3] = '4';
+
+        wh->wh_riffsize = len;
+        wh->wh_datasize = dlen;
+        wh->wh_samplecount = nframes;
+
+        wh->wh_dlen = (uint32_t) _WH_RIFF_MAX;
+    }
+
+    wh->wh_ds64len = 28;
+
+    wh->wh_WAVE[0] = 'W';   wh->wh_WAVE[1] = 'A';
+    wh->wh_WAVE[2] = 'V';   wh->wh_WAVE[3] = 'E';
+
+    wh->wh_fmt_[0] = 'f';   wh->wh_fmt_[1] = 'm';
+    wh->wh_fmt_[2] = 't';   wh->wh_fmt_[3] = ' ';
+
+    wh->wh_chans = _WH_CHANNELS;
+
+    wh->wh_samprate = rate;
+
+    wh->wh_bytespersec = rate * _WH_CHANNELS * bytes;
+
+    wh->wh_bytespersmp = _WH_CHANNELS * bytes;
+    wh->wh_bitsperchan = bytes * 8;
+
+    /* plain PCM where that is enough, it is what the simplest readers know */
+    if ( bits > 16 )
+    {
+        wh->wh_fmtlen = 40;
+        wh->wh_format = 0xfffe;     /* WAVE_FORMAT_EXTENSIBLE */
+
+        wh->wh_fmtx.ext.cbsize = 22;
+        wh->wh_fmtx.ext.validbits = bits;
+        wh->wh_fmtx.ext.chanmask = 0x3;  /* SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT */
+        memcpy( wh->wh_fmtx.ext.subformat, s_wh_pcm, sizeof(s_wh_pcm) );
+    }
+    else
+    {
+        wh->wh_fmtlen = 16;
+        wh->wh_format = 1;          /* PCM */
+
+        wh->wh_fmtx.pcm.junk[0] = 'J';  wh->wh_fmtx.pcm.junk[1] = 'U';
+        wh->wh_fmtx.pcm.junk[2] = 'N';  wh->wh_fmtx.pcm.junk[3] = 'K';
+        wh->wh_fmtx.pcm.junklen = sizeof(wh->wh_fmtx.pcm.pad);
+    }
+
+    wh->wh_data[0] = 'd';   wh->wh_data[1] = 'a';
+    wh->wh_data[2] = 't';   wh->wh_data[3] = 'a';
+}
+
+static void ww_Flush( struct SpdifWavWriter *ww )
+{
+    if ( ww->fill && (ww->fill != fwrite( ww->buf, 1, ww->fill, ww->f )) )
+        ww->err = 1;
+
+    ww->fill = 0;
+}
+
+/*
+ *    4-27           Sample
+ *   (A 24-bit sample can be used (using bits 4-27).
+ *    A CD-player uses only 16 bits, so only bits
+ *    13 (LSB) to 27 (MSB) are used. Bits 4-12 are
+ *    set to 0).
+ *
+ *  A 20-bit sample is bits 8-27, in the top of a 24-bit one.
+ */
+static inline void ww_Sample( struct SpdifWavWriter *ww, uint32_t raw )
+{
+    uint32_t    pcm = (raw >> ww->shift) & ww->mask;
+
+    if ( ww->fill + ww->bytes > SPDIF_WAV_BUFFER_BYTES )
+    {
+        unsigned int    i;
+
+        /* the buffer is full, or a sample is split across the end of it */
+        for ( i = 0; i < ww->bytes; i++, pcm >>= 8 )
+        {
+            if ( SPDIF_WAV_BUFFER_BYTES == ww->fill )
+                ww_Flush( ww );
+
+            ww->buf[ww->fill++] = (unsigned char) pcm;
+        }
+        return;
+    }
+
+    ww->buf[ww->fill++] = (unsigned char)(pcm >>  0);
+    ww->buf[ww->fill++] = (unsigned char)(pcm >>  8);
+    if ( 3 == ww->bytes )
+        ww->buf[ww->fill++] = (unsigned char)(pcm >> 16);
+}
+
+struct SpdifWavWriter *SpdifWavWriter_Open(
+    const char          *path,
+    uint32_t             rate,
+    unsigned int         bits )
+{
+    struct SpdifWavWriter   *ww;
+
+    if ( NULL == (ww = (struct SpdifWavWriter *)calloc(1,sizeof(*ww))) )
+        return(NULL);
+
+    if ( NULL == (ww->f = fopen(path,"wb")) )
+    {
+        free( ww );
+        return(NULL);
+    }
+
+    if ( (SPDIF_WAV_BITS_20 != bits) && (SPDIF_WAV_BITS_24 != bits) )
+        bits = SPDIF_WAV_BITS_16;
+
+    ww->rate = rate;
+    ww->bits = bits;
+    ww->bytes = (bits > 16) ? 3 : 2;
+    ww->shift = 28 - (ww->bytes * 8);
+    ww->mask = ((1u << bits) - 1) << ((ww->bytes * 8) - bits);
+
+    /* a placeholder header, so the samples that follow are where they belong */
+    wh_Init( (struct WAVHeader *) ww->buf, 0, rate, bits );
+    ww->fill = sizeof(struct WAVHeader);
+
+    return(ww);
+}
+
+void SpdifWavWriter_SetRate(
+    struct SpdifWavWriter   *ww,
+    uint32_t                 rate )
+{
+    ww->rate = rate;
+}
+
+void SpdifWavWriter_Subframe(
+    struct SpdifWavWriter   *ww,
+    enum SpdifFrameType      ft,
+    uint32_t                 raw )
+{
+    if ( sft_W == ft ) {    /* right channel */
+        if ( ! ww->half ) { /* missing sample ? */
+            ww_Sample( ww, raw );
+        }
+        ww_Sample( ww, raw );
+        ww->nframes++;
+        ww->half = 0;
+    } else {
+        if ( ww->half ) {   /* missing sample ? */
+            ww_Sample( ww, raw );
+            ww->nframes++;
+        }
+        ww_Sample( ww, raw );
+        ww->left = raw;
+        ww->half = 1;
+    }
+}
+
+enum SpdifFrameType SpdifRunFrameType(
+    enum SpdifFrameType      first,
+    uint64_t                 k )
+{
+    if ( 0 == k )
+        return( first );
+
+    /* odd repeats are on the other side */
+    return( ((sft_W == first) == (0 == (k & 1))) ? sft_W : sft_M );
+}
+
+void SpdifWavWriter_Run(
+    struct SpdifWavWriter   *ww,
+    enum SpdifFrameType      first,
+    uint32_t                 raw,
+    uint64_t                 repeats )
+{
+    uint64_t    k = 0;
+
+    /* a run that starts on the right, or a subframe that completes a frame */
+    for ( ; (k < repeats) && ((0 == k) || ww->half); k++ )
+        SpdifWavWriter_Subframe( ww, SpdifRunFrameType( first, k ), raw );
+
+    /* whole frames from here on, then a left of its own */
+    if ( (repeats - k) >> 1 )
+        SpdifWavWriter_Stereo( ww, raw, raw, (repeats - k) >> 1 );
+    if ( (repeats - k) & 1 )
+        SpdifWavWriter_Subframe( ww, sft_M, raw );
+}
+
+void SpdifWavWriter_Stereo(
+    struct SpdifWavWriter   *ww,
+    uint32_t                 left,
+    uint32_t                 right,
+    uint64_t                 repeats )
+{
+    if ( ww->half ) {       /* right channel missing before this frame ? */
+        ww_Sample( ww, left );
+        ww->nframes++;
+        ww->half = 0;
+    }
+
+    for ( uint64_t k = 0; k < repeats; k++ )
+    {
+        ww_Sample( ww, left );
+        ww_Sample( ww, right );
+    }
+
+    ww->nframes += repeats;
+}
+
+uint64_t SpdifWavWriter_Frames( struct SpdifWavWriter *ww )
+{
+    return( ww->nframes );
+}
+
+int SpdifWavWriter_Close( struct SpdifWavWriter *ww )
+{
+    struct WAVHeader    wh;
+    int                 err;
+
+    /* a left channel on its own at the end gets a right */
+    if ( ww->half )
+    {
+        ww_Sample( ww, ww->left );
+        ww->nframes++;
+        ww->half = 0;
+    }
+
+    ww_Flush( ww );
+
+    wh_Init( &wh, ww->nframes, ww->rate, ww->bits );
+    rewind( ww->f );
+    if ( 1 != fwrite( &wh, sizeof(wh), 1, ww->f ) )
+        ww->err = 1;
+
+    if ( 0 != fclose( ww->f ) )
+        ww->err = 1;
+
+    err = ww->err ? -1 : 0;
+    free( ww );
+
+    return(err);
+}
+
+uint32_t SpdifChannelStatus_Rate( const unsigned char *channel_status )
+{
+    /* consumer bits 24-27, with bit 24 in the lowest bit */
+    static const uint32_t   consumer[16] =
+    {
+        44100, 0, 48000, 32000, 22050, 0, 24000, 0,
+        88200, 768000, 96000, 0, 176400, 0, 192000, 0
+    };
+    /* professional bits 6-7 */
+    static const uint32_t   professional[4] = { 0, 44100, 48000, 32000 };
+
+    if ( channel_status[0] & 0x01 )
+        return( professional[ (channel_status[0] >> 6) & 0x3 ] );
+
+    return( consumer[ channel_status[3] & 0xf ] );
+}
+
+uint32_t SpdifNominalRate(
+    uint64_t             nframes,
+    uint64_t             ticks,
+    uint32_t             tick_rate )
+{
+    static const uint32_t   rates[] =
+    {
+        8000, 11025, 16000, 22050, 24000, 32000, 44100, 48000,
+        64000, 88200, 96000, 128000, 176400, 192000, 352800, 384000, 768000
+    };
+    double      rate;
+    uint32_t    best = rates[0];
+    size_t      i;
+
+    if ( 0 == ticks )
+        return(0);
+
+    rate = (double) nframes * tick_rate / ticks;
+
+    for ( i = 1; i < sizeof(rates)/sizeof(rates[0]); i++ )
+    {
+        if ( fabs( rate - rates[i] ) < fabs( rate - best ) )
+            best = rates[i];
+    }
+
+    return(best);
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* Edge trace */
+/* -------------------------------------------------------------------------------------------- */
+
+#define SPDIF_TRACE_BUFFER_BYTES    (1<<20)
+
+/* most one edge adds to the buffer, a 10 byte varint and the sync record after it */
+#define _TW_EDGE_BYTES_MAX          (10 + SPDIF_TRACE_RECORD_BYTES)
+
+struct SpdifTraceWriter
+{
+    FILE            *f;
+    uint64_t         edges;
+    uint64_t         time;          /* ticks from origin */
+    uint64_t         next_sync;     /* edges at the next sync record */
+    int              err;
+    size_t           fill;
+    unsigned char    buf[SPDIF_TRACE_BUFFER_BYTES];
+};
+
+static inline void tw_Put32( unsigned char *p, uint32_t v )
+{
+    p[0] = (unsigned char)(v >>  0);    p[1] = (unsigned char)(v >>  8);
+    p[2] = (unsigned char)(v >> 16);    p[3] = (unsigned char)(v >> 24);
+}
+
+static inline void tw_Put64( unsigned char *p, uint64_t v )
+{
+    tw_Put32( p, (uint32_t) v );
+    tw_Put32( p + 4, (uint32_t)(v >> 32) );
+}
+
+static void tw_Flush( struct SpdifTraceWriter *tw )
+{
+    if ( tw->fill && (tw->fill != fwrite( tw->buf, 1, tw->fill, tw->f )) )
+        tw->err = 1;
+
+    tw->fill = 0;
+}
+
+static void tw_Record( struct SpdifTraceWriter *tw, const char *tag )
+{
+    unsigned char  *p = tw->buf + tw->fill;
+
+    memcpy( p, tag, 4 );
+    tw_Put64( p + 4, tw->edges );
+    tw_Put64( p + 12, tw->time );
+    tw->fill += SPDIF_TRACE_RECORD_BYTES;
+}
+
+static inline void tw_Edge( struct SpdifTraceWriter *tw, uint64_t dt )
+{
+    uint64_t        v = dt + 1;     /* never a 0 byte */
+    unsigned char  *p;
+
+    if ( tw->fill > SPDIF_TRACE_BUFFER_BYTES - _TW_EDGE_BYTES_MAX )
+        tw_Flush( tw );
+
+    p = tw->buf + tw->fill;
+
+    while ( v >= 0x80 )
+    {
+        *p++ = (unsigned char)( v | 0x80 );
+        v >>= 7;
+    }
+    *p++ = (unsigned char) v;
+
+    tw->fill = (size_t)( p - tw->buf );
+    tw->time += dt;
+
+    if ( ++tw->edges == tw->next_sync )
+    {
+        tw_Record( tw, SPDIF_TRACE_SYNC );
+        tw->next_sync += SPDIF_TRACE_SYNC_EDGES;
+    }
+}
+
+template <typename In>
+static void tw_Widths( struct SpdifTraceWriter *tw, const In *dt, size_t n )
+{
+    size_t      i;
+
+    for ( i = 0; i < n; i++ )
+        tw_Edge( tw, dt[i] );
+}
+
+struct SpdifTraceWriter *SpdifTraceWriter_Open(
+    const char          *path,
+    uint64_t             rate,
+    uint64_t             origin,
+    unsigned int         level )
+{
+    struct SpdifTraceWriter *tw;
+
+    if ( NULL == (tw = (struct SpdifTraceWriter *)calloc(1,sizeof(*tw))) )
+        return(NULL);
+
+    if ( NULL == (tw->f = fopen(path,"wb")) )
+    {
+        free( tw );
+        return(NULL);
+    }
+
+    memcpy( tw->buf, SPDIF_TRACE_MAGIC, 8 );
+    tw_Put32( tw->buf + 8, SPDIF_TRACE_VERSION );
+    tw_Put32( tw->buf + 12, level ? 1 : 0 );
+    tw_Put64( tw->buf + 16, rate );
+    tw_Put64( tw->buf + 24, origin );
+    tw->fill = SPDIF_TRACE_HEADER_BYTES;
+
+    tw->next_sync = SPDIF_TRACE_SYNC_EDGES;
+
+    return(tw);
+}
+
+void SpdifTraceWriter_Edge(
+    struct SpdifTraceWriter *tw,
+    uint64_t                 dt )
+{
+    tw_Edge( tw, dt );
+}
+
+void SpdifTraceWriter_Edges(
+    struct SpdifTraceWriter *tw,
+    const uint32_t          *dt,
+    size_t                   n )
+{
+    tw_Widths( tw, dt, n );
+}
+
+void SpdifTraceWriter_Flush( struct SpdifTraceWriter *tw )
+{
+    tw_Flush( tw );
+
+    if ( 0 != fflush( tw->f ) )
+        tw->err = 1;
+}
+
+int SpdifTraceWriter_Close( struct SpdifTraceWriter *tw )
+{
+    int         err;
+
+    if ( tw->fill > SPDIF_TRACE_BUFFER_BYTES - SPDIF_TRACE_RECORD_BYTES )
+        tw_Flush( tw );
+
+    tw_Record( tw, SPDIF_TRACE_END );
+    tw_Flush( tw );
+
+    if ( 0 != fclose( tw->f ) )
+        tw->err = 1;
+
+    err = tw->err ? -1 : 0;
+    free( tw );
+
+    return(err);
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* Public API */
+/* -------------------------------------------------------------------------------------------- */
+
+int SpdifBitstreamAnalyzer_AddEdge(
+    struct SpdifBitstreamAnalyzer   *sba,
+    uint16_t                         dt,
+    uint16_t                         bitval )
+{
+    (void)bitval;   /* every edge is a transition, the level is not needed */
+
+    if ( NULL != sba->trace )
+        tw_Edge( sba->trace, dt );
+
+    sba->dec.AddEdge( dt );
+
+    return(0);
+}
+
+int SpdifBitstreamAnalyzer_AddEdges(
+    struct SpdifBitstreamAnalyzer   *sba,
+    const uint16_t                  *dt,
+    size_t                           n )
+{
+    if ( NULL != sba->trace )
+        tw_Widths( sba->trace, dt, n );
+
+    sba->dec.AddEdges( dt, n );
+
+    return(0);
+}
+
+int SpdifBitstreamAnalyzer_AddSamples(
+    struct SpdifBitstreamAnalyzer   *sba,
+    const uint64_t                  *words,
+    size_t                           nsamples )
+{
+    uint64_t    widths[SPDIF_SAMPLE_BATCH_WORDS * 64 + SBA_EDGES_SLACK];
+
+    while ( nsamples > 0 )
+    {
+        size_t  take = (nsamples < SPDIF_SAMPLE_BATCH_WORDS * 64) ? nsamples : (SPDIF_SAMPLE_BATCH_WORDS * 64);
+        size_t  n = sba->bits.Find( words, take, widths );
+
+        if ( NULL != sba->trace )
+            tw_Widths( sba->trace, widths, n );
+
+        /* the widths may be longer than 16 bits, AddEdges() keeps the excess */
+        sba->dec.AddEdges( widths, n );
+
+        words += SPDIF_SAMPLE_BATCH_WORDS;
+        nsamples -= take;
+    }
+
+    return(0);
+}
+
+void SpdifBitstreamAnalyzer_SetSubframeBuffer(
+    struct SpdifBitstreamAnalyzer   *sba,
+    struct SpdifSubframeBuffer      *buf )
+{
+    sba->sink.out.buf = buf;
+}
+
+size_t SpdifBitstreamAnalyzer_FillSubframeBuffer(
+    struct SpdifBitstreamAnalyzer   *sba,
+    const uint16_t                  *dt,
+    size_t                           n )
+{
+    struct SpdifSubframeBuffer      *buf = sba->sink.out.buf;
+    size_t                           take;
+
+    take = sba->dec.EdgesFor( buf->capacity - buf->count );
+    if ( take > n )
+        take = n;
+
+    if ( NULL != sba->trace )
+        tw_Widths( sba->trace, dt, take );
+
+    sba->dec.AddEdges( dt, take );
+
+    return(take);
+}
+
+void SpdifBitstreamAnalyzer_SetTrace(
+    struct SpdifBitstreamAnalyzer   *sba,
+    struct SpdifTraceWriter         *tw )
+{
+    sba->trace = tw;
+}
+
+void SpdifBitstreamAnalyzer_SetBlockIndex(
+    struct SpdifBitstreamAnalyzer   *sba,
+    struct SpdifBlockIndex          *index )
+{
+    sba->index = index;
+    sba->dec.index = index;
+}
+
+size_t SpdifBlockIndex_Find(
+    const struct SpdifBlockIndex    *index,
+    uint64_t                         sample )
+{
+    size_t      lo = 0;
+    size_t      hi = index->nblocks;
+
+    /* last block starting at or before sample */
+    while ( hi - lo > 1 )
+    {
+        size_t  mid = lo + ((hi - lo) >> 1);
+
+        if ( index->block_time[mid] <= sample )
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return(lo);
+}
+
+const struct SpdifDecoderCheckpoint *SpdifBlockIndex_Checkpoint(
+    const struct SpdifBlockIndex    *index,
+    size_t                           block )
+{
+    size_t      interval = index->interval ? index->interval : 1;
+    size_t      i = block / interval;
+
+    if ( 0 == index->ncheckpoints )
+        return(NULL);
+
+    if ( i >= index->ncheckpoints )
+        i = index->ncheckpoints - 1;
+
+    return( &index->checkpoint[i] );
+}
+
+void SpdifBitstreamAnalyzer_Checkpoint(
+    struct SpdifBitstreamAnalyzer   *sba,
+    struct SpdifDecoderCheckpoint   *cp )
+{
+    sba->dec.Save( cp );
+}
+
+uint64_t SpdifBitstreamAnalyzer_Restore(
+    struct SpdifBitstreamAnalyzer   *sba,
+    const struct SpdifDecoderCheckpoint *cp,
+    const uint16_t                  *dt )
+{
+    sba->dec.Restore( cp, dt );
+
+    /* the buffer's gap flag carries on from the last subframe before the checkpoint */
+    sba->sink.out.prev_end = cp->n_syncs ? cp->sync_end_time : 0;
+    sba->sink.out.relocked = 0;
+    sba->sink.out.suspect = 0;
+    sba->sink.out.block = 0;
+
+    return( cp->w_edgenum );
+}
+
+void SpdifBitstreamAnalyzer_GetStats(
+    struct SpdifBitstreamAnalyzer   *sba,
+    struct SpdifDecoderStats        *stats )
+{
+    *stats = sba->dec.stats;
+}
+
+void SpdifBitstreamAnalyzer_Delete( struct SpdifBitstreamAnalyzer *sba )
+{
+    free ( sba );
+}
+
+void SpdifBitstreamAnalyzer_SetRelockCallbacks(
+    struct SpdifBitstreamAnalyzer   *sba,
+    struct SpdifRelockCallbacks     *callbacks )
+{
+    if ( NULL != callbacks )
+        sba->sink.rcb = *callbacks;
+    else
+        memset( &sba->sink.rcb, 0, sizeof(sba->sink.rcb) );
+}
+
+void SpdifBitstreamAnalyzer_Reset( struct SpdifBitstreamAnalyzer *sba )
+{
+    sba->dec.Reset();
+    sba->dec.index = sba->index;
+    sba->bits.Reset();
+
+    sba->sink.out.prev_end = 0;
+    sba->sink.out.relocked = 0;
+    sba->sink.out.suspect = 0;
+    sba->sink.out.dropped = 0;
+    sba->sink.out.block = 0;
+}
+
+struct SpdifBitstreamAnalyzer *SpdifBitstreamAnalyzer_Create( 
+    struct SpdifBitstreamCallbacks *callbacks )
+{
+    struct SpdifBitstreamAnalyzer   *sba;
+
+    if ( NULL != (sba = (struct SpdifBitstreamAnalyzer *)calloc(1,sizeof(*sba))) )
+    {
+        /* copy the whole struct */
+        sba->sink.cb = *callbacks;
+        sba->dec.sink = &sba->sink;
+    }
+
+    return(sba);
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* Parallel decode */
+/* -------------------------------------------------------------------------------------------- */
+
+typedef SpdifDecoder<uint16_t,SPDIF_ANALYZER_WINDOW_EDGES,SpdifSubframeWriter>  SpdifChunkDecoder;
+
+/* smallest share of the edges worth a chunk of its own, about 5 blocks of a 48 kHz stream */
+#define SPDIF_PARALLEL_MIN_EDGES    (1<<17)
+
+/* several chunks per thread, so one slow chunk does not leave the others idle */
+#define SPDIF_PARALLEL_CHUNKS       4
+
+struct SpdifChunk
+{
+    size_t                      from;       /* start of the even share of the edges, block aligned */
+    uint64_t                    from_time;  /* and the time it starts at */
+    size_t                      seam;       /* first edge whose subframes belong to this chunk */
+    size_t                      end;        /* and one past the last */
+
+    SpdifChunkDecoder           entry;      /* decoder state at seam */
+    SpdifChunkDecoder           exit;       /* decoder state at end */
+    SpdifSubframeWriter         writer;
+
+    std::vector<uint64_t>       t_start;
+    std::vector<uint64_t>       t_end;
+    std::vector<unsigned char>  type;
+    std::vector<uint32_t>       raw;
+    std::vector<unsigned char>  flags;
+    struct SpdifSubframeBuffer  buf;
+};
+
+/* run job(0) .. job(njobs-1) on up to nthreads threads, each takes the next job as it finishes one */
+template <class Job>
+static void sba_RunJobs(
+    unsigned int                     nthreads,
+    size_t                           njobs,
+    Job                              job )
+{
+    std::atomic<size_t>         next( 0 );
+    std::vector<std::thread>    pool;
+    auto                        work = [&]()
+    {
+        size_t      i;
+
+        while ( (i = next++) < njobs )
+            job( i );
+    };
+
+    for ( size_t i = 1; (i < nthreads) && (i < njobs); i++ )
+        pool.push_back( std::thread( work ) );
+
+    work();
+
+    for ( size_t i = 0; i < pool.size(); i++ )
+        pool[i].join();
+}
+
+/* (re)size a chunk's subframe buffer, dropping what it held */
+static void sba_ChunkBuffer(
+    struct SpdifChunk               *k,
+    size_t                           cap )
+{
+    k->t_start.resize( cap );
+    k->t_end.resize( cap );
+    k->type.resize( cap );
+    k->raw.resize( cap );
+    k->flags.resize( cap );
+
+    k->buf.t_start = &k->t_start[0];
+    k->buf.t_end = &k->t_end[0];
+    k->buf.type = &k->type[0];
+    k->buf.raw = &k->raw[0];
+    k->buf.flags = &k->flags[0];
+    k->buf.capacity = cap;
+    k->buf.count = 0;
+
+    k->writer.buf = &k->buf;
+}
+
+/*
+ *  Decode from the start of a share up to its first B preamble and the subframe
+ *  after it, the refresh that comes with that subframe makes the state one that
+ *  the chunk before can arrive at too.  Leaves seam at 0 if there is none before
+ *  to, the share then stays with the chunk before.
+ */
+static void sba_FindSeam(
+    const uint16_t                  *dt,
+    size_t                           to,
+    struct SpdifChunk               *k )
+{
+    size_t          e = k->from;
+    size_t          s = 0;
+    int             seen_b = 0;
+
+    memset( &k->writer, 0, sizeof(k->writer) );
+    sba_ChunkBuffer( k, ((to - k->from) >> 5) + 1 );
+
+    k->exit.sink = &k->writer;
+    k->exit.Seek( k->from, k->from_time );
+
+    k->seam = 0;
+
+    while ( e < to )
+    {
+        size_t      step = (to - e < SBA_BLOCK_EDGES) ? (to - e) : SBA_BLOCK_EDGES;
+
+        k->exit.AddEdges( dt + e, step );
+        e += step;
+
+        for ( ; s < k->buf.count; s++ )
+        {
+            if ( seen_b )
+            {
+                k->seam = e;
+                break;
+            }
+
+            seen_b = (sft_B == k->type[s]);
+        }
+
+        if ( 0 != k->seam )
+            break;
+    }
+
+    /* subframes up to here belong to the chunk before */
+    k->buf.count = 0;
+    k->entry = k->exit;
+}
+
+/*
+ *  The capture is cut into even shares, and a decoder started at each one from
+ *  scratch.  Once it has seen a B preamble it decodes exactly like the decoder
+ *  of the chunk before would have from there, as long as SameCourse() holds
+ *  between the two at the seam.  A chunk where it does not is decoded again
+ *  carrying on from the chunk before, so the result never depends on how the
+ *  capture was split.
+ */
+size_t SpdifDecodeParallel(
+    const uint16_t                  *dt,
+    size_t                           n,
+    unsigned int                     nthreads,
+    int                              stop,
+    struct SpdifSubframeBuffer      *out )
+{
+    size_t                      nshares,nchunks,i;
+    size_t                      total = 0;
+    uint64_t                    t = 0;
+    uint64_t                    prev_end = 0;
+
+    if ( 0 == nthreads )
+        nthreads = std::thread::hardware_concurrency();
+    if ( 0 == nthreads )
+        nthreads = 1;
+
+    nshares = nthreads * SPDIF_PARALLEL_CHUNKS;
+    if ( nshares > n / SPDIF_PARALLEL_MIN_EDGES )
+        nshares = n / SPDIF_PARALLEL_MIN_EDGES;
+    if ( nshares < 1 )
+        nshares = 1;
+
+    std::vector<SpdifChunk>     chunks( nshares );
+    std::vector<uint64_t>       share_time( nshares );
+
+    for ( i = 0; i < nshares; i++ )
+        chunks[i].from = (i * (n / nshares)) & ~(size_t)SBA_BLOCK_MASK;
+
+    /* the time each share starts at, from the sum of the widths before it */
+    sba_RunJobs( nthreads, nshares, [&]( size_t c )
+    {
+        size_t      to = (c + 1 < nshares) ? chunks[c + 1].from : n;
+        uint64_t    sum = 0;
+
+        for ( size_t e = chunks[c].from; e < to; e++ )
+            sum += dt[e];
+
+        share_time[c] = sum;
+    });
+
+    for ( i = 0; i < nshares; i++ )
+    {
+        chunks[i].from_time = t;
+        t += share_time[i];
+    }
+
+    sba_RunJobs( nthreads, nshares - 1, [&]( size_t c )
+    {
+        size_t      to = (c + 2 < nshares) ? chunks[c + 2].from : n;
+
+        sba_FindSeam( dt, to, &chunks[c + 1] );
+    });
+
+    /* shares that found no seam stay with the chunk before */
+    chunks[0].seam = 0;
+    for ( i = nchunks = 1; i < nshares; i++ )
+    {
+        if ( 0 != chunks[i].seam )
+        {
+            if ( nchunks != i )
+                std::swap( chunks[nchunks], chunks[i] );
+            nchunks++;
+        }
+    }
+
+    chunks.resize( nchunks );
+
+    for ( i = 0; i < nchunks; i++ )
+        chunks[i].end = (i + 1 < nchunks) ? chunks[i + 1].seam : n;
+
+    sba_RunJobs( nthreads, nchunks, [&]( size_t c )
+    {
+        SpdifChunk     *k = &chunks[c];
+
+        /* room for a window of edges carried over too, in case the seam does not hold */
+        sba_ChunkBuffer( k, ((k->end - k->seam + SPDIF_ANALYZER_WINDOW_EDGES) >> 5) + 1 );
+
+        if ( 0 == c )
+        {
+            memset( &k->writer, 0, sizeof(k->writer) );
+            k->writer.buf = &k->buf;
+            k->exit.sink = &k->writer;
+            k->exit.Reset();
+        }
+
+        k->exit.AddEdges( dt + k->seam, k->end - k->seam );
+    });
+
+    /* stitch, checking each seam */
+    for ( i = 0; i < nchunks; i++ )
+    {
+        SpdifChunk     *k = &chunks[i];
+        size_t          s;
+
+        if ( (i > 0) && !k->entry.SameCourse( chunks[i - 1].exit ) )
+        {
+            /* not settled by the seam, carry on from where the chunk before left off */
+            k->exit = chunks[i - 1].exit;
+            k->exit.sink = &k->writer;
+            k->buf.count = 0;
+            k->exit.AddEdges( dt + k->seam, k->end - k->seam );
+        }
+
+        /* as the plugin does before it starts over */
+        if ( stop && (i + 1 == nchunks) )
+            k->exit.Drain();
+
+        for ( s = 0; s < k->buf.count; s++, total++ )
+        {
+            unsigned char   flags = k->flags[s] & ~SPDIF_SF_GAP;
+
+            /* each chunk's writer only knew the subframes before it from its own warmup */
+            if ( (0 != prev_end) && (prev_end != k->t_start[s]) )
+                flags |= SPDIF_SF_GAP;
+
+            prev_end = k->t_end[s];
+
+            if ( out->count < out->capacity )
+            {
+                size_t  o = out->count++;
+
+                out->t_start[o] = k->t_start[s];
+                out->t_end[o] = k->t_end[s];
+                out->type[o] = k->type[s];
+                out->raw[o] = k->raw[s];
+                out->flags[o] = flags;
+            }
+        }
+    }
+
+    return(total);
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* Self-Test */
+/* -------------------------------------------------------------------------------------------- */
+
+#ifdef SELF_TEST
+
+static void print_sample   ( void *userdata, uint64_t t, uint64_t tend, enum SpdifFrameType ft, uint32_t aud_sample )
+{
+    struct SpdifBitstreamAnalyzer   *sba = (struct SpdifBitstreamAnalyzer *)userdata;
+
+    if ( NULL != sba->fout )
+    {
+        unsigned char   raw[4];
+
+        raw[0] = (unsigned char)(aud_sample >>  0);
+        raw[1] = (unsigned char)(aud_sample >>  8);
+        raw[2] = (unsigned char)(aud_sample >> 16);
+        raw[3] = (unsigned char)(aud_sample >> 24);
+
+        fwrite( raw, sizeof(raw), 1, sba->fout );
+    }
+
+    if ( NULL != sba->wav )
+    {
+        SpdifWavWriter_Subframe( sba->wav, ft, aud_sample );
+    }
+}
+
+static void print_chstatus ( void *userdata, uint64_t t, uint64_t tend, const unsigned char *chstatus, const unsigned char *chstatus_r, int error_present )
+{
+    unsigned int    cs_byte;
+
+    struct SpdifBitstreamAnalyzer   *sba = (struct SpdifBitstreamAnalyzer *)userdata;
+    if ( sba->dec.n_b_syncs > 1 ) {
+        printf("@%12lu->%12lu B[%2ld,%2ld,", t, tend,
+            sba->dec.n_syncs - sba->dec.last_b_sync - sba->dec.prev_b_nsyncs,
+            (sba->dec.EdgeTime( sba->dec.r_edgenum ) - sba->dec.last_b_time - sba->dec.prev_b_dt) );
+    } else {
+        printf("@%12lu->%12lu B[%2ld,%2ld,", t, tend,
+            sba->dec.n_syncs - sba->dec.last_b_sync,
+            sba->dec.EdgeTime( sba->dec.r_edgenum ) - sba->dec.last_b_time );
+    }
+
+    printf("%02x%02x%02x%02x] [",
+        (sba->dec.sample >>  0) & 0xff,
+        (sba->dec.sample >>  8) & 0xff,
+        (sba->dec.sample >> 16) & 0xff,
+        (sba->dec.sample >> 24) & 0xff );
+
+    for ( cs_byte = 0; cs_byte < CHANNEL_STATUS_NBYTES; cs_byte++ )
+    {
+        printf("%02x", chstatus[cs_byte] );
+    }
+}
+
+static void print_subframe ( void *userdata, uint64_t t, const unsigned char *subframe, const unsigned char *subframe_r, int error_present )
+{
+    #define PRINT_SUBFRAME
+    #ifdef PRINT_SUBFRAME
+//    struct SpdifBitstreamAnalyzer   *sba = (struct SpdifBitstreamAnalyzer *)userdata;
+    unsigned int    cs_byte;
+    printf("] [");
+    for ( cs_byte = 0; cs_byte < CHANNEL_STATUS_NBYTES; cs_byte++ )
+    {
+        unsigned char        ch;
+
+        ch = subframe[cs_byte];
+
+        printf("%02x", ch );
+    }
+    #endif
+}
+
+static void print_validity ( void *userdata, uint64_t t, const unsigned char *validity, const unsigned char *validity_r, int error_present )
+{
+    #define PRINT_VALIDITY
+    #ifdef PRINT_VALIDITY
+//    struct SpdifBitstreamAnalyzer   *sba = (struct SpdifBitstreamAnalyzer *)userdata;
+    unsigned int    cs_byte;
+    printf("] [");
+    for ( cs_byte = 0; cs_byte < CHANNEL_STATUS_NBYTES; cs_byte++ )
+    {
+        unsigned char        ch;
+
+        ch = validity[cs_byte];
+      #if 1
+        if ( 0 == ch )          ch = '-';
+        else if ( 0xff == ch )  ch = '!';
+        else                    ch = '#';
+        printf("%c", ch );
+      #else
+        printf("%02x", ch );
+      #endif
+    }
+    #endif
+}
+
+static void print_status ( void *userdata, uint64_t t, uint64_t tend, struct SpdifChannelStatus *status )
+{
+    struct SpdifBitstreamAnalyzer   *sba = (struct SpdifBitstreamAnalyzer *)userdata;
+    unsigned int    cs_byte;
+
+    print_chstatus(userdata,t,tend,status->channel_status_left,status->channel_status_right,0);
+    print_subframe(userdata,t,status->subframe_left,status->subframe_right,0);
+    print_validity(userdata,t,status->validity_left,status->validity_right,0);
+
+    if ( (NULL != sba->wav) && (0 != SpdifChannelStatus_Rate( status->channel_status_left )) )
+    {
+        SpdifWavWriter_SetRate( sba->wav, SpdifChannelStatus_Rate( status->channel_status_left ) );
+    }
+
+    /* example Channelstatus: 000c00020000000.... */
+
+    /*
+     * Channelstatus and subcode information
+     * 
+     * In each block, 384 bits of channelstatus and subcode info are transmitted. The 
+     * Channel-status bits are equal for both subframes, so actually only 192 useful
+     * bits are transmitted:
+     * 
+     *    bit            meaning
+     *    -------------------------------------------------------------
+     *    0-3            controlbits:
+     * 
+     *   bit 0: 0 (is set to 1 during 4 channel transmission)
+     *   bit 1: 0=Digital audio, 1=Non-audio   (reserved to be 0 on old S/PDIF specs)
+     *   bit 2: copy-protection. Copying is allowed
+     *  when this bit is set.
+     *                   bit 3: is set when pre-emphasis is used.
+     * 
+     *    4-7            0 (reserved)
+     * 
+     *    9-15           catagory-code:
+     * 
+     *   0 = common 2-channel format
+     *   1 = 2-channel CD-format
+     *       (set by a CD-player when a subcode is
+     *        transmitted)
+     *                   2 = 2-channel PCM-encoder-decoder format
+     * 
+     *                   others are not used
+     * 
+     *    19-191         0 (reserved)
+     * 
+     * The subcode-bits can be used by the manufacturer at will. They are used
+     * in blocks of 1176 bits before which a sync-word of 16 "0"-bits is transmitted
+     */
+
+    if ( sba->dec.n_b_syncs > 1 ) {
+        /* compare left/right channel status bits */
+        if ( memcmp(sba->dec.cur_cs.channel_status_left,
+                    sba->dec.cur_cs.channel_status_right,
+                    sizeof(sba->dec.cur_cs.channel_status_left)))
+        {
+            printf("] [%d..%d] [", sba->dec.last_threshold_12, sba->dec.last_threshold_23);
+            for ( cs_byte = 0; cs_byte < CHANNEL_STATUS_NBYTES; cs_byte++ )
+            {
+                printf("%02x", sba->dec.cur_cs.channel_status_right[cs_byte] );
+            }
+            printf("] err?\n");
+        }
+        else
+        {
+            printf("]\n");
+        }
+    }
+}
+
+static void print_relock ( void *userdata, uint64_t t, uint64_t tend, uint32_t nedges )
+{
+    printf("relock @%12lu->%12lu (%lu ticks, %u edges)\n", t, tend, tend - t, nedges );
+}
+
+int main ( int argc, char *argv[] )
+{
+    int         err = 0;
+    uint64_t    last_t = 0;
+    int         last_bitval=0;
+    uint64_t    sample_num = 0;;
+    unsigned int wav_bits = SPDIF_WAV_BITS_16;  /* 16, 20 or 24 */
+    struct SpdifBitstreamAnalyzer   *sba = &s_sba;
+
+    /* set callbacks */
+    sba->sink.cb.userdata = sba;
+    sba->sink.cb.cb_sample = print_sample;
+    sba->sink.cb.cb_status = print_status;
+    sba->sink.rcb.cb_relock = print_relock;
+    sba->dec.sink = &sba->sink;
+
+    if ( argc > 1 )
+    {
+        if ( NULL != (sba->fout = fopen(argv[1],"w")) )
+        {
+            printf("opened \"%s\" for output\n", argv[1] );
+        }
+    }
+
+    if ( argc > 3 )
+    {
+        wav_bits = atoi(argv[3]);
+    }
+
+    if ( argc > 2 )
+    {
+        /* 48 kHz until a channel status block says otherwise */
+        if ( NULL != (sba->wav = SpdifWavWriter_Open(argv[2],48000,wav_bits)) )
+        {
+            printf("opened \"%s\" for output\n", argv[2] );
+        }
+    }
+
+
+#ifdef GUI_DEBUGGER
+    {
+ // programmatically redirect stdio
+    assert( dup2(open("test.csv" ,O_RDONLY),0) != -1 );
+    }
+#endif
+
+    while ( ! feof(stdin) )
+    {
+        uint64_t    now;
+        int         bitval;
+
+        scanf("%lu, %d",&now,&bitval);
+        sample_num++;
+
+        /* only record changes */
+        if ( bitval != last_bitval )
+        {
+            /* push into analysis */
+            SpdifBitstreamAnalyzer_AddEdge(sba,now-last_t,bitval);
+            last_t = now;
+            last_bitval = bitval;
+        }
+    }
+
+    printf("DONE: Read %ld samples\n", sample_num );
+
+    printf("acquire: %lu subframes, %lu edges, %lu ticks\n",
+        sba->dec.stats.acquire_subframes, sba->dec.stats.acquire_edges, sba->dec.stats.acquire_time );
+    printf("track:   %lu subframes, %lu edges, %lu ticks, %lu locks, %lu unlocks, %lu refreshes\n",
+        sba->dec.stats.track_subframes, sba->dec.stats.track_edges, sba->dec.stats.track_time,
+        sba->dec.stats.locks, sba->dec.stats.unlocks, sba->dec.stats.refreshes );
+    printf("relock:  %lu subframes, %lu edges, %lu ticks, %lu relocks, %lu fallbacks, lost %lu ticks (max %lu), %lu suspect\n",
+        sba->dec.stats.relock_subframes, sba->dec.stats.relock_edges, sba->dec.stats.relock_time,
+        sba->dec.stats.relocks, sba->dec.stats.relock_fallbacks,
+        sba->dec.stats.lost_time, sba->dec.stats.lost_time_max, sba->dec.stats.suspect_subframes );
+
+    if ( NULL != sba->wav )
+    {
+        if ( 0 != SpdifWavWriter_Close( sba->wav ) )
+        {
+            printf("error writing \"%s\"\n", argv[2] );
+            err = 1;
+        }
+        sba->wav = NULL;
+    }
+
+    if ( NULL != sba->fout )
+    {
+        fclose( sba->fout );
+        sba->fout = NULL;
+    }
+
+    return(err);
+}
+
+#endif /* SELF_TEST */
@@ -26,6 +26,13 @@
 
 */
 
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 enum SpdifFrameType {
     sft_invalid,
     sft_B,
@@ -52,13 +59,245 @@ struct SpdifBitstreamCallbacks
     void (*cb_status)   ( void *userdata, uint64_t t, uint64_t tend, struct SpdifChannelStatus *status );
 };
 
+/*
+ *  Optional callbacks, see SpdifBitstreamAnalyzer_SetRelockCallbacks(), they are
+ *  passed the userdata of struct SpdifBitstreamCallbacks.  Either may be NULL.
+ */
+struct SpdifRelockCallbacks
+{
+    /* sync lost at t and found again at tend after nedges edges */
+    void (*cb_relock)   ( void *userdata, uint64_t t, uint64_t tend, uint32_t nedges );
+    /* the subframe at t..tend, reported next, is not followed by a preamble */
+    void (*cb_suspect)  ( void *userdata, uint64_t t, uint64_t tend );
+};
+
+/* per-subframe flags in struct SpdifSubframeBuffer */
+#define SPDIF_SF_PARITY     0x01    /* parity over bits 4-31 is odd */
+#define SPDIF_SF_GAP        0x02    /* does not start where the previous subframe ended */
+#define SPDIF_SF_RELOCK     0x04    /* first subframe after sync was lost and found again */
+#define SPDIF_SF_SUSPECT    0x08    /* not followed by a preamble, lock was lost in it and its bits are suspect */
+#define SPDIF_SF_BLOCK      0x10    /* a full channel status block ended just before this subframe */
+
+/*
+ *  Caller-provided structure-of-arrays output, one entry per subframe, see
+ *  SpdifBitstreamAnalyzer_SetSubframeBuffer().  The decoder appends at count
+ *  and never goes past capacity, the caller drains it by resetting count.
+ */
+struct SpdifSubframeBuffer
+{
+    uint64_t           *t_start;
+    uint64_t           *t_end;
+    unsigned char      *type;       /* enum SpdifFrameType */
+    uint32_t           *raw;        /* the 32-bit word, preamble in bits 0-3 */
+    unsigned char      *flags;      /* SPDIF_SF_x */
+    size_t              capacity;
+    size_t              count;
+};
+
+/* where the decoder spent its time, ticks are in sample units of the edge dt's */
+struct SpdifDecoderStats
+{
+    uint64_t    acquire_subframes;  /* decoded while searching for sync */
+    uint64_t    acquire_edges;
+    uint64_t    acquire_time;
+    uint64_t    track_subframes;    /* decoded while locked */
+    uint64_t    track_edges;
+    uint64_t    track_time;
+    uint64_t    relock_subframes;   /* decoded while relocking after a lost lock */
+    uint64_t    relock_edges;
+    uint64_t    relock_time;
+    uint64_t    locks;              /* acquire/relock -> track */
+    uint64_t    unlocks;            /* track -> relock */
+    uint64_t    refreshes;          /* threshold updates while locked */
+    uint64_t    relocks;            /* lock regained with the previous thresholds */
+    uint64_t    relock_fallbacks;   /* relock gave up and went back to acquire */
+    uint64_t    lost_time;          /* ticks from losing lock to regaining it, summed */
+    uint64_t    lost_time_max;
+    uint64_t    suspect_subframes;  /* not followed by a preamble, lock was lost in them */
+};
+
+/*
+ *  Decoder state at some point in a stream, everything but the widths of the
+ *  last few edges, which are reloaded from the capture when it is restored.
+ */
+struct SpdifDecoderCheckpoint
+{
+    uint64_t            block;          /* channel status block it was taken in */
+    uint64_t            w_edgenum;      /* edges added so far, decoding carries on from this one */
+    uint64_t            r_edgenum;
+    uint64_t            c_edgenum;
+    uint64_t            t_edgenum;
+    uint64_t            t_time;
+    uint64_t            n_syncs;
+    uint64_t            sync_start_time;    /* the last subframe decoded */
+    uint64_t            sync_end_time;
+    uint64_t            prev_b_dt;
+    uint64_t            prev_b_nsyncs;
+    uint64_t            n_b_syncs;
+    uint64_t            last_b_sync;
+    uint64_t            last_b_time;
+    uint64_t            lost_edgenum;
+    uint64_t            lost_time;
+    uint16_t            last_threshold_12;
+    uint16_t            last_threshold_23;
+    uint16_t            threshold_12;
+    uint16_t            threshold_23;
+    uint16_t            good_threshold_12;
+    uint16_t            good_threshold_23;
+    int                 state;
+    unsigned int        since_refresh;
+    int                 lost_sync;
+    uint32_t            sample;
+    unsigned int        channel_status_left_bits;
+    unsigned int        channel_status_right_bits;
+    struct SpdifDecoderStats    stats;
+    struct SpdifChannelStatus   cur_cs;
+    struct SpdifChannelStatus   prev_cs;
+};
+
+/*
+ *  Caller-provided index of the channel status blocks, filled in as they are
+ *  decoded.  Block n starts at block_time[n], the sample its B preamble starts
+ *  at.  Every interval blocks a checkpoint is taken just after the B subframe,
+ *  checkpoint[i] is in block i*interval.  Entries past a capacity are dropped,
+ *  and blocks already indexed are not added again when decoding over them.
+ */
+struct SpdifBlockIndex
+{
+    uint64_t                       *block_time;
+    size_t                          block_capacity;
+    size_t                          nblocks;
+    struct SpdifDecoderCheckpoint  *checkpoint;
+    size_t                          checkpoint_capacity;
+    size_t                          ncheckpoints;
+    unsigned int                    interval;
+};
+
 /* pre-declaration for the API */
 struct SpdifBitstreamAnalyzer;
 struct WAVHeader;
+struct SpdifWavWriter;
+struct SpdifTraceWriter;
+
+/* WAV sample sizes, bits 4-27 of a subframe hold up to 24 */
+#define SPDIF_WAV_BITS_16       16
+#define SPDIF_WAV_BITS_20       20
+#define SPDIF_WAV_BITS_24       24
 
+/* a stereo header for nframes left/right pairs, RF64 when the file would pass 4 GB */
 void wh_Init(
     struct WAVHeader    *wh,
-    uint32_t             nsamples );
+    uint64_t             nframes,
+    uint32_t             rate,
+    unsigned int         bits );
+
+/*
+ *  Buffered stereo WAV output.  The header is filled in on Close(), until then
+ *  the rate can still be changed.  Returns NULL if the file can not be created.
+ */
+struct SpdifWavWriter *SpdifWavWriter_Open(
+    const char          *path,
+    uint32_t             rate,
+    unsigned int         bits );
+
+void SpdifWavWriter_SetRate(
+    struct SpdifWavWriter   *ww,
+    uint32_t                 rate );
+
+/*
+ *  Add one subframe, raw as decoded.  A left or right that is missing is
+ *  filled in with the sample that follows it, so the channels stay paired.
+ */
+void SpdifWavWriter_Subframe(
+    struct SpdifWavWriter   *ww,
+    enum SpdifFrameType      ft,
+    uint32_t                 raw );
+
+/*
+ *  The type of subframe k of a run of repeats that starts with a subframe of
+ *  type first.  Left and right alternate, only the first can be a B.
+ */
+enum SpdifFrameType SpdifRunFrameType(
+    enum SpdifFrameType      first,
+    uint64_t                 k );
+
+/* add a run of repeats of one raw subframe, starting on first's side and alternating */
+void SpdifWavWriter_Run(
+    struct SpdifWavWriter   *ww,
+    enum SpdifFrameType      first,
+    uint32_t                 raw,
+    uint64_t                 repeats );
+
+/* add a left/right pair of raw subframes, repeats times */
+void SpdifWavWriter_Stereo(
+    struct SpdifWavWriter   *ww,
+    uint32_t                 left,
+    uint32_t                 right,
+    uint64_t                 repeats );
+
+/* stereo frames written so far */
+uint64_t SpdifWavWriter_Frames( struct SpdifWavWriter *ww );
+
+/* write the header and close, returns 0, or -1 if anything failed to write */
+int SpdifWavWriter_Close( struct SpdifWavWriter *ww );
+
+/*
+ *  Edge trace, the edge widths a decoder was given, small enough to attach to
+ *  a bug report and read back by spdif_decode at full speed.  All little endian:
+ *
+ *    char      magic[8]    "SPDIFTRC"
+ *    uint32    version     1
+ *    uint32    level       of the line before the first edge, 0 or 1
+ *    uint64    rate        ticks per second, 0 when not known
+ *    uint64    origin      tick the first width is measured from
+ *
+ *  then each width as an unsigned LEB128 varint of dt+1, a single byte up to
+ *  126 ticks.  A 0 byte never comes up in those and starts a record:
+ *
+ *    char      tag[4]      "\0SYN" every SPDIF_TRACE_SYNC_EDGES edges, "\0END" after the last
+ *    uint64    edges       before this point
+ *    uint64    time        ticks from origin to this point
+ *
+ *  so a trace that was cut short or damaged is read up to the last good record.
+ */
+#define SPDIF_TRACE_MAGIC           "SPDIFTRC"
+#define SPDIF_TRACE_VERSION         1
+#define SPDIF_TRACE_HEADER_BYTES    32
+#define SPDIF_TRACE_SYNC            "\0SYN"
+#define SPDIF_TRACE_END             "\0END"
+#define SPDIF_TRACE_RECORD_BYTES    20
+#define SPDIF_TRACE_SYNC_EDGES      (1<<16)
+
+/* buffered trace output, NULL if the file can not be created */
+struct SpdifTraceWriter *SpdifTraceWriter_Open(
+    const char          *path,
+    uint64_t             rate,
+    uint64_t             origin,
+    unsigned int         level );
+
+void SpdifTraceWriter_Edge(
+    struct SpdifTraceWriter *tw,
+    uint64_t                 dt );
+
+void SpdifTraceWriter_Edges(
+    struct SpdifTraceWriter *tw,
+    const uint32_t          *dt,
+    size_t                   n );
+
+/* write out what is buffered, the trace so far can then be read */
+void SpdifTraceWriter_Flush( struct SpdifTraceWriter *tw );
+
+/* end the trace and close, returns 0, or -1 if anything failed to write */
+int SpdifTraceWriter_Close( struct SpdifTraceWriter *tw );
+
+/* the sample rate a channel status block gives, 0 when it does not */
+uint32_t SpdifChannelStatus_Rate( const unsigned char *channel_status );
+
+/* the standard rate closest to nframes in ticks at tick_rate, 0 if ticks is 0 */
+uint32_t SpdifNominalRate(
+    uint64_t             nframes,
+    uint64_t             ticks,
+    uint32_t             tick_rate );
 
 struct SpdifBitstreamAnalyzer *SpdifBitstreamAnalyzer_Create( 
     struct SpdifBitstreamCallbacks *callbacks );
@@ -67,9 +306,122 @@ void SpdifBitstreamAnalyzer_Reset( struct SpdifBitstreamAnalyzer *sba );
 
 void SpdifBitstreamAnalyzer_Delete( struct SpdifBitstreamAnalyzer *sba );
 
+/* copies *callbacks, NULL clears them, they are kept over Reset() */
+void SpdifBitstreamAnalyzer_SetRelockCallbacks(
+    struct SpdifBitstreamAnalyzer   *sba,
+    struct SpdifRelockCallbacks     *callbacks );
+
 int SpdifBitstreamAnalyzer_AddEdge(
     struct SpdifBitstreamAnalyzer   *sba,
     uint16_t                         dt,
     uint16_t                         bitval );
 
+/* same as calling AddEdge() for each of the n edge widths in turn */
+int SpdifBitstreamAnalyzer_AddEdges(
+    struct SpdifBitstreamAnalyzer   *sba,
+    const uint16_t                  *dt,
+    size_t                           n );
+
+/* record every edge added from here on in tw, NULL to stop */
+void SpdifBitstreamAnalyzer_SetTrace(
+    struct SpdifBitstreamAnalyzer   *sba,
+    struct SpdifTraceWriter         *tw );
+
+/*
+ *  Raw samples instead of edges, for captures that are just the line sampled
+ *  at a fixed rate.  1 bit per sample packed 64 to a word, the first sample in
+ *  bit 0 of words[0], so a little endian byte stream with the first sample in
+ *  bit 0 of each byte.  A call may end part way through a word, the next one
+ *  starts at bit 0 of its own words[0].  Times are in samples from the first
+ *  one added since the last Reset().
+ */
+int SpdifBitstreamAnalyzer_AddSamples(
+    struct SpdifBitstreamAnalyzer   *sba,
+    const uint64_t                  *words,
+    size_t                           nsamples );
+
+/*
+ *  Buffered output, subframes are appended to buf instead of going to cb_sample.
+ *  Channel status and relock callbacks are still made.  NULL goes back to cb_sample.
+ */
+void SpdifBitstreamAnalyzer_SetSubframeBuffer(
+    struct SpdifBitstreamAnalyzer   *sba,
+    struct SpdifSubframeBuffer      *buf );
+
+/*
+ *  Like AddEdges(), but only takes as many of the n edges as are certain to
+ *  decode into the room left in the subframe buffer.  Returns the number
+ *  taken, fewer than n means the buffer has to be drained first.  An empty
+ *  buffer always takes edges as long as its capacity is 4 or more.
+ */
+size_t SpdifBitstreamAnalyzer_FillSubframeBuffer(
+    struct SpdifBitstreamAnalyzer   *sba,
+    const uint16_t                  *dt,
+    size_t                           n );
+
+/*
+ *  No edge for this long is the signal stopping, not a long pulse.  The plugin
+ *  starts decoding over after it, and so does spdif_decode when it knows the
+ *  capture's rate, so a trace replays as it was decoded.
+ */
+#define SPDIF_IDLE_GAP_MS       1
+
+/*
+ *  Decode a whole capture of n edge widths at once, on nthreads threads (0 for
+ *  one per core).  The capture is split into chunks at B preambles, which are
+ *  decoded separately and joined up again.  The subframes appended to out are
+ *  exactly what buffered mode of a single SpdifBitstreamAnalyzer gives for the
+ *  same edges.  With stop set the signal ends after them, as at an idle gap,
+ *  and the whole subframes still waiting for more edges are decoded too.
+ *  Returns the number decoded, those past out->capacity are not stored, a
+ *  capacity of n/32 always holds them all.
+ */
+size_t SpdifDecodeParallel(
+    const uint16_t                  *dt,
+    size_t                           n,
+    unsigned int                     nthreads,
+    int                              stop,
+    struct SpdifSubframeBuffer      *out );
+
+/* record blocks and checkpoints in index as they are decoded, NULL to stop */
+void SpdifBitstreamAnalyzer_SetBlockIndex(
+    struct SpdifBitstreamAnalyzer   *sba,
+    struct SpdifBlockIndex          *index );
+
+/* the block sample falls in, 0 before the first */
+size_t SpdifBlockIndex_Find(
+    const struct SpdifBlockIndex    *index,
+    uint64_t                         sample );
+
+/* the last checkpoint taken at or before block, NULL if there is none */
+const struct SpdifDecoderCheckpoint *SpdifBlockIndex_Checkpoint(
+    const struct SpdifBlockIndex    *index,
+    size_t                           block );
+
+/* save the decoder state, between AddEdge() calls */
+void SpdifBitstreamAnalyzer_Checkpoint(
+    struct SpdifBitstreamAnalyzer   *sba,
+    struct SpdifDecoderCheckpoint   *cp );
+
+/*
+ *  Go back to a saved state.  dt holds the edge widths of the whole capture
+ *  the checkpoint came from, the last few before the checkpoint are reloaded
+ *  from it.  Returns the edge to carry on adding from, the callbacks that
+ *  follow are the same as the first time through.  An index checkpoint was
+ *  taken after its block's B subframe, which is in sample, sync_start_time
+ *  and sync_end_time.
+ */
+uint64_t SpdifBitstreamAnalyzer_Restore(
+    struct SpdifBitstreamAnalyzer   *sba,
+    const struct SpdifDecoderCheckpoint *cp,
+    const uint16_t                  *dt );
+
+void SpdifBitstreamAnalyzer_GetStats(
+    struct SpdifBitstreamAnalyzer   *sba,
+    struct SpdifDecoderStats        *stats );
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* SPDIF_BITSTREAM_ANALYZER_H */
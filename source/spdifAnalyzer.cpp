@@ -27,37 +27,31 @@
 #include "spdifAnalyzerSettings.h"
 #include <AnalyzerChannelData.h>
 
-/* add the "C" bitstream parser library as code and set up some "C" callback stubs */
-extern "C" {
-
-#include "spdif.c"
-
-static void c_sample_callback( void *userdata, uint64_t t, uint64_t tend, enum SpdifFrameType ft, uint32_t aud_sample )
-{
-    spdifAnalyzer   *sba = (spdifAnalyzer *)userdata;
-    sba->sample_callback(t,tend,ft,aud_sample);
-}
-
-static void c_status_callback( void *userdata, uint64_t t, uint64_t tend, struct SpdifChannelStatus *status )
-{
-    spdifAnalyzer   *sba = (spdifAnalyzer *)userdata;
-    sba->status_callback(t,tend,status);
-}
-
-};
-
 spdifAnalyzer::spdifAnalyzer()
 :	Analyzer2(),  
 	mSettings( new spdifAnalyzerSettings() ),
-	mSimulationInitilized( false )
+	mSimulationInitilized( false ),
+	mPipeFetched( 0 ),
+	mPipeDecoded( 0 ),
+	mPipeDrained( 0 ),
+	mPipeStop( false ),
+	mTrace( NULL )
 {
-    struct SpdifBitstreamCallbacks  cb;
-
-    cb.userdata = this;
-    cb.cb_sample = c_sample_callback;
-    cb.cb_status = c_status_callback;
-
-    mSba = SpdifBitstreamAnalyzer_Create(&cb);
+    mDecoder8.sink = &mWriter;
+    mDecoder16.sink = &mWriter;
+
+    for ( int i = 0; i < SPDIF_PIPE_DEPTH; i++ )
+    {
+        spdifPipeSlot   *slot = &mPipe[i];
+
+        slot->out.t_start = slot->t_start;
+        slot->out.t_end = slot->t_end;
+        slot->out.type = slot->type;
+        slot->out.raw = slot->raw;
+        slot->out.flags = slot->flags;
+        slot->out.capacity = SPDIF_PIPE_SUBFRAMES;
+        slot->out.count = 0;
+    }
 
 	SetAnalyzerSettings( mSettings.get() );
 }
@@ -65,7 +59,10 @@ spdifAnalyzer::spdifAnalyzer()
 spdifAnalyzer::~spdifAnalyzer()
 {
 	KillThread();
-    SpdifBitstreamAnalyzer_Delete( mSba );
+    StopDecodeThread();
+
+    if ( NULL != mTrace )
+        SpdifTraceWriter_Close( mTrace );
 }
 
 void spdifAnalyzer::SetupResults()
@@ -75,6 +72,21 @@ void spdifAnalyzer::SetupResults()
     mResults->AddChannelBubblesWillAppearOn( mSettings->mInputChannel );
 }
 
+/* spin briefly on an empty/full ring, then stop burning the core while it stays that way */
+static void pipe_wait( unsigned int &spins )
+{
+    if ( ++spins < 64 )
+        std::this_thread::yield();
+    else
+        std::this_thread::sleep_for( std::chrono::microseconds( 200 ) );
+}
+
+/*
+ *  Edges are fetched here and handed a batch at a time to the decode thread,
+ *  whose subframes come back here to be committed, since the results can only
+ *  be touched from this thread.  Fetching runs ahead of decoding by at most
+ *  SPDIF_PIPE_DEPTH batches.
+ */
 void spdifAnalyzer::WorkerThread()
 {
 	mSampleRateHz = GetSampleRate();
@@ -86,21 +98,407 @@ void spdifAnalyzer::WorkerThread()
     mPrevSample = mPrevStatus = prev_edge;
     mPrevSampleEnd = mPrevStatusEnd = prev_edge;
     mSamplesSinceLastBSync = 0;
+    mBlocksSinceHeartbeat = 0;
+    mLastBStart = 0;
+    mFramesSinceCommit = 0;
+    mLastCommit = std::chrono::steady_clock::now();
+    mHaveLeft = false;
+    mRunCount = 0;
+    mBlockOpen = false;
+
+    /* a rerun starts a fresh pipeline, and trace */
+    StopDecodeThread();
+
+    if ( NULL != mTrace )
+    {
+        SpdifTraceWriter_Close( mTrace );
+        mTrace = NULL;
+    }
 
-    SpdifBitstreamAnalyzer_Reset(mSba);
+    /* at the usual oversampling every edge width fits a byte */
+    mNarrowDt = ( mSampleRateHz <= SPDIF_NARROW_DT_MAX_RATE );
+
+    if ( sfm_overview == mSettings->mFrameMode )
+    {
+        if ( mNarrowDt )
+            OverviewProbes( mDecoder8, prev_edge );
+        else
+            OverviewProbes( mDecoder16, prev_edge );
+        return;
+    }
+
+    /* the overview skips most edges, there is nothing to replay */
+    if ( mSettings->mTraceEdges )
+        mTrace = SpdifTraceWriter_Open( mSettings->mTracePath.c_str(), mSampleRateHz, prev_edge,
+                                        (BIT_HIGH == mSerial->GetBitState()) ? 1 : 0 );
+
+    uint64_t    fetched = 0;
+    U64         idle = (U64) mSampleRateHz * SPDIF_IDLE_GAP_MS / 1000;
+    bool        restart = true;
+    U64         restart_time = prev_edge;
+
+    mPipeFetched.store( 0 );
+    mPipeDecoded.store( 0 );
+    mPipeDrained = 0;
+    mPipeStop.store( false );
+    mDecodeThread = std::thread( &spdifAnalyzer::DecodeThread, this );
 
 	for( ; ; )
 	{
-		mSerial->AdvanceToNextEdge();
+        unsigned int    spins = 0;
+
+        /* backpressure, commit results until the decoder frees a slot */
+        while ( fetched - mPipeDrained == SPDIF_PIPE_DEPTH )
+        {
+            uint64_t    drained = mPipeDrained;
+
+            DrainResults();
+            if ( drained == mPipeDrained )
+                pipe_wait( spins );
+        }
+
+        spdifPipeSlot   *slot = &mPipe[ fetched % SPDIF_PIPE_DEPTH ];
+        bool            more;
+        U64             gap = 0;
+
+        slot->restart = restart;
+        slot->restart_time = restart_time;
+        restart = false;
+
+        slot->n_edges = 0;
+        do
+        {
+            mSerial->AdvanceToNextEdge();
+
+            U64 cur_edge = mSerial->GetSampleNumber();
+            U64 width = cur_edge - prev_edge;
+
+            prev_edge = cur_edge;
+
+            more = mSerial->DoMoreTransitionsExistInCurrentData();
+
+            /*
+             *  Unplugged or idle: rather than have the decoder lose lock on the
+             *  gap and hunt its way back, send what came before on its own and
+             *  start over from the edge that ended the gap.
+             */
+            if ( width > idle )
+            {
+                restart = true;
+                restart_time = cur_edge;
+                gap = width;
+                break;
+            }
+
+            slot->edge_dt[ slot->n_edges++ ] = (uint32_t) width;
+        }
+        while ( more && (slot->n_edges < SPDIF_EDGE_BATCH) );
+
+        mPipeFetched.store( ++fetched, std::memory_order_release );
 
-		U64 cur_edge = mSerial->GetSampleNumber();
+        /* the trace keeps the gap, spdif_decode starts over at it too */
+        if ( NULL != mTrace )
+        {
+            SpdifTraceWriter_Edges( mTrace, slot->edge_dt, slot->n_edges );
+            if ( 0 != gap )
+                SpdifTraceWriter_Edge( mTrace, gap );
+        }
 
-		SpdifBitstreamAnalyzer_AddEdge( mSba, cur_edge - prev_edge, mSerial->GetBitState() == BIT_HIGH );
+        /* never sit on decoded subframes while waiting for more data */
+        if ( !more )
+        {
+            spins = 0;
+            while ( mPipeDecoded.load( std::memory_order_acquire ) != fetched )
+            {
+                DrainResults();
+                pipe_wait( spins );
+            }
+
+            DrainResults();
+            FlushRun();
+            CommitPending( true );
+
+            /* everything up to here can be read back while the capture goes on */
+            if ( NULL != mTrace )
+                SpdifTraceWriter_Flush( mTrace );
+        }
 
-        prev_edge = cur_edge;
+        DrainResults();
 	}
 }
 
+/*
+ *  Lock on, decode up to a B preamble and the subframe after it, then jump
+ *  ahead mOverviewBlocks blocks without fetching the edges in between.  The
+ *  results can only be added to, so the full decode that fills in behind is
+ *  a rerun with another frame setting.
+ */
+template <class Decoder>
+void spdifAnalyzer::OverviewProbes( Decoder &dec, U64 prev_edge )
+{
+    spdifPipeSlot   *slot = &mPipe[0];
+    U64             block_len = mSampleRateHz / 250;    /* a 48 kHz block, until one is measured */
+    U64             idle = (U64) mSampleRateHz * SPDIF_IDLE_GAP_MS / 1000;
+
+    mWriter.buf = &slot->out;
+    mWriter.lost = slot->lost;
+
+    for ( ; ; )
+    {
+        U64         probe_start = prev_edge;
+        U64         next;
+        size_t      searched = 0;
+        size_t      b = 0;
+        bool        found = false;
+        bool        gap = false;
+
+        /* times carry on from where the probe starts */
+        dec.Seek( 0, prev_edge );
+        mWriter.prev_end = 0;
+        mWriter.relocked = 0;
+        mWriter.suspect = 0;
+        mWriter.block = 0;
+        slot->out.count = 0;
+
+        while ( !found && !gap && (searched < SPDIF_OVERVIEW_SEARCH_EDGES) )
+        {
+            bool    more;
+
+            /* decode what has arrived rather than wait for a whole batch */
+            slot->n_edges = 0;
+            do
+            {
+                mSerial->AdvanceToNextEdge();
+
+                U64 cur_edge = mSerial->GetSampleNumber();
+                U64 width = cur_edge - prev_edge;
+
+                prev_edge = cur_edge;
+
+                more = mSerial->DoMoreTransitionsExistInCurrentData();
+
+                /* as in WorkerThread(), an idle gap ends the probe */
+                if ( width > idle )
+                {
+                    gap = true;
+                    break;
+                }
+
+                slot->edge_dt[ slot->n_edges++ ] = (uint32_t) width;
+            }
+            while ( more && (slot->n_edges < SPDIF_EDGE_BATCH) );
+
+            searched += slot->n_edges;
+            dec.AddEdges( slot->edge_dt, slot->n_edges );
+
+            for ( b = 0; b + 1 < slot->out.count; b++ )
+            {
+                if ( sft_B == slot->type[b] )
+                {
+                    found = true;
+                    break;
+                }
+            }
+
+            if ( found )
+                break;
+
+            /* a B that came last still needs the subframe after it */
+            b = slot->out.count - 1;
+            if ( slot->out.count && (sft_B == slot->type[b]) )
+            {
+                slot->t_start[0] = slot->t_start[b];
+                slot->t_end[0] = slot->t_end[b];
+                slot->type[0] = slot->type[b];
+                slot->raw[0] = slot->raw[b];
+                slot->flags[0] = slot->flags[b];
+                slot->out.count = 1;
+            }
+            else
+            {
+                slot->out.count = 0;
+            }
+        }
+
+        Frame frame;
+
+        /* the line went idle before a B came, start over on the edge that ended the gap */
+        if ( gap && !found )
+            continue;
+
+        if ( found )
+        {
+            uint64_t    t = slot->t_start[b];
+
+            if ( sft_W == slot->type[b+1] )
+            {
+                frame.mData1 = slot->raw[b];
+                frame.mData2 = slot->raw[b+1];
+                frame.mFlags = SPDIF_FRAME_FLAG_B;
+                frame.mEndingSampleInclusive = slot->t_end[b+1];
+                frame.mType = SPDIF_FT_STEREO;
+            }
+            else
+            {
+                frame.mData1 = SPDIF_PCM16( slot->raw[b] );
+                frame.mData2 = slot->raw[b];
+                frame.mFlags = 0;
+                frame.mEndingSampleInclusive = slot->t_end[b];
+                frame.mType = sft_B;
+            }
+            frame.mStartingSampleInclusive = t+1;
+            mResults->AddFrame( frame );
+
+            if ( smm_all == mSettings->mMarkerMode )
+                mResults->AddMarker( t, AnalyzerResults::Dot, mSettings->mInputChannel );
+
+            /* a block is 192 frames, aim half a block early to lock before the B */
+            block_len = ( slot->t_end[b+1] - t ) * 192;
+            next = t + block_len * mSettings->mOverviewBlocks - (block_len >> 1);
+        }
+        else
+        {
+            frame.mData1 = prev_edge - probe_start;
+            frame.mData2 = 0;
+            frame.mFlags = DISPLAY_AS_ERROR_FLAG;    /* no lock */
+            frame.mStartingSampleInclusive = probe_start+1;
+            frame.mEndingSampleInclusive = prev_edge;
+            frame.mType = sft_invalid;
+            mResults->AddFrame( frame );
+
+            mResults->AddMarker( probe_start, AnalyzerResults::ErrorX, mSettings->mInputChannel );
+
+            next = prev_edge + block_len * mSettings->mOverviewBlocks;
+        }
+
+        mPrevSampleEnd = frame.mEndingSampleInclusive;
+        mFramesSinceCommit++;
+        CommitPending( true );
+
+        /* the next probe starts on an edge, so its first width is a whole one */
+        if ( next > prev_edge )
+            mSerial->AdvanceToAbsPosition( next );
+        mSerial->AdvanceToNextEdge();
+        prev_edge = mSerial->GetSampleNumber();
+    }
+}
+
+void spdifAnalyzer::DecodeThread()
+{
+    mWriter.buf = NULL;
+    mWriter.lost = NULL;
+    mWriter.lost_ticks = 0;
+    mWriter.prev_end = 0;
+    mWriter.relocked = 0;
+    mWriter.suspect = 0;
+    mWriter.block = 0;
+    mWriter.dropped = 0;
+
+    if ( mNarrowDt )
+        DecodeSlots( mDecoder8 );
+    else
+        DecodeSlots( mDecoder16 );
+}
+
+template <class Decoder>
+void spdifAnalyzer::DecodeSlots( Decoder &dec )
+{
+    uint64_t    decoded = 0;
+
+    dec.Reset();
+
+    while ( !mPipeStop.load( std::memory_order_relaxed ) )
+    {
+        if ( decoded == mPipeFetched.load( std::memory_order_acquire ) )
+        {
+            unsigned int    spins = 0;
+
+            while ( (decoded == mPipeFetched.load( std::memory_order_acquire ))
+                 && !mPipeStop.load( std::memory_order_relaxed ) )
+                pipe_wait( spins );
+            continue;
+        }
+
+        spdifPipeSlot   *slot = &mPipe[ decoded % SPDIF_PIPE_DEPTH ];
+
+        slot->out.count = 0;
+        mWriter.buf = &slot->out;
+        mWriter.lost = slot->lost;
+
+        if ( slot->restart )
+        {
+            dec.Drain();
+            dec.Seek( 0, slot->restart_time );
+        }
+
+        dec.AddEdges( slot->edge_dt, slot->n_edges );
+
+        mPipeDecoded.store( ++decoded, std::memory_order_release );
+    }
+}
+
+void spdifAnalyzer::StopDecodeThread()
+{
+    if ( mDecodeThread.joinable() )
+    {
+        mPipeStop.store( true );
+        mDecodeThread.join();
+    }
+}
+
+void spdifAnalyzer::DrainResults()
+{
+    uint64_t    decoded = mPipeDecoded.load( std::memory_order_acquire );
+
+    for ( ; mPipeDrained != decoded; mPipeDrained++ )
+    {
+        spdifPipeSlot   *slot = &mPipe[ mPipeDrained % SPDIF_PIPE_DEPTH ];
+
+        for ( size_t i = 0; i < slot->out.count; i++ )
+        {
+            if ( sft_B == slot->type[i] )
+            {
+                if ( slot->flags[i] & SPDIF_SF_BLOCK )
+                    status_callback( mLastBStart, slot->t_start[i], NULL );
+                mLastBStart = slot->t_start[i];
+            }
+
+            sample_callback( slot->t_start[i], slot->t_end[i],
+                             (enum SpdifFrameType) slot->type[i], slot->raw[i], slot->flags[i],
+                             (slot->flags[i] & SPDIF_SF_RELOCK) ? slot->lost[i] : 0 );
+        }
+
+        CommitPending( false );
+    }
+}
+
+/*
+ *  Committing makes the frames visible, but takes the results lock and wakes
+ *  the UI each time.  Commit when enough frames have piled up or the oldest
+ *  has waited as long as the latency setting allows, and whenever asked to
+ *  if there is anything to commit.
+ */
+void spdifAnalyzer::CommitPending( bool force )
+{
+    std::chrono::steady_clock::time_point   now;
+
+    if ( 0 == mFramesSinceCommit )
+        return;
+
+    now = std::chrono::steady_clock::now();
+
+    if ( !force &&
+         (mFramesSinceCommit < SPDIF_COMMIT_FRAMES) &&
+         (now - mLastCommit < std::chrono::milliseconds( mSettings->mCommitLatencyMs )) )
+        return;
+
+    mResults->CommitResults();
+    ReportProgress( mPrevSampleEnd );
+
+    mFramesSinceCommit = 0;
+    mLastCommit = now;
+}
+
 bool spdifAnalyzer::NeedsRerun()
 {
 	return false;
@@ -142,41 +540,59 @@ void DestroyAnalyzer( Analyzer* analyzer )
 	delete analyzer;
 }
 
-void spdifAnalyzer::sample_callback( uint64_t t, uint64_t tend, enum SpdifFrameType ft, uint32_t aud_sample )
+/* lost is how long sync was lost for before a subframe with SPDIF_SF_RELOCK, it goes in the gap frame */
+void spdifAnalyzer::sample_callback( uint64_t t, uint64_t tend, enum SpdifFrameType ft, uint32_t aud_sample, unsigned char flags, uint64_t lost )
 {
+    bool gap = (mPrevSampleEnd != t) && (mPrevSampleEnd != 0);
+
     //let's put a dot exactly where we sample this bit:
-    if ( (mPrevSampleEnd != t) && (mPrevSampleEnd != 0) ) {
-        Frame eframe;
-        eframe.mData1 = t-mPrevSampleEnd;
-        eframe.mData2 = 0;
-        eframe.mFlags = DISPLAY_AS_ERROR_FLAG;    /* gap marker */
-        eframe.mStartingSampleInclusive = mPrevSampleEnd+1;
-        eframe.mEndingSampleInclusive = t-1;
-        eframe.mType = sft_invalid;
-        mResults->AddFrame( eframe );
+    if ( gap ) {
+        if ( sfm_block != mSettings->mFrameMode ) {     /* a block frame counts its gaps instead */
+            Frame eframe;
+
+            FlushLeft();                                /* frames go in time order */
+            FlushRun();
+
+            eframe.mData1 = t-mPrevSampleEnd;
+            eframe.mData2 = lost;
+            eframe.mFlags = DISPLAY_AS_ERROR_FLAG;    /* gap marker */
+            eframe.mStartingSampleInclusive = mPrevSampleEnd+1;
+            eframe.mEndingSampleInclusive = t-1;
+            eframe.mType = sft_invalid;
+            mResults->AddFrame( eframe );
+        }
 
         mResults->AddMarker( mPrevSampleEnd, AnalyzerResults::ErrorX, mSettings->mInputChannel );
     }
 
+    /* bad parity, lock lost in it, or the first subframe after the preambles were lost */
+    if ( flags & (SPDIF_SF_PARITY | SPDIF_SF_SUSPECT | SPDIF_SF_RELOCK) )
+        mResults->AddMarker( t, AnalyzerResults::ErrorSquare, mSettings->mInputChannel );
+
     Frame frame;
 
     mSamplesSinceLastBSync++;
 
     if ( sft_B == ft ) {
-        if ( 384 == mSamplesSinceLastBSync ) {
-            mResults->AddMarker( t, AnalyzerResults::Dot, mSettings->mInputChannel );
-        } else {
+        if ( 384 != mSamplesSinceLastBSync ) {
             mResults->AddMarker( t, AnalyzerResults::ErrorDot, mSettings->mInputChannel );
+        } else if ( smm_all == mSettings->mMarkerMode ) {
+            mResults->AddMarker( t, AnalyzerResults::Dot, mSettings->mInputChannel );
+        } else if ( (smm_heartbeat == mSettings->mMarkerMode) &&
+                    (++mBlocksSinceHeartbeat >= SPDIF_HEARTBEAT_BLOCKS) ) {
+            mResults->AddMarker( t, AnalyzerResults::Dot, mSettings->mInputChannel );
+            mBlocksSinceHeartbeat = 0;
         }
         mSamplesSinceLastBSync = 0;
     }
 
-    frame.mData1 = ((int)aud_sample<<4) >> 16;   /* signed 16-bit audio sample */
+    frame.mData1 = SPDIF_PCM16( aud_sample );   /* signed 16-bit audio sample */
 
 	/* special sequence for embedded AC3 data */
 	if ((0xf872 == m_PrevPCM) && (0x4e1f == frame.mData1)) {
 		/* this looks like an AC3 stream */
-		mResults->AddMarker(mPrevSample, AnalyzerResults::UpArrow, mSettings->mInputChannel);
+		if ( smm_all == mSettings->mMarkerMode )
+			mResults->AddMarker(mPrevSample, AnalyzerResults::UpArrow, mSettings->mInputChannel);
 		m_AC3_Detected++;
 	}
 	m_PrevPCM = (U16)frame.mData1;
@@ -186,20 +602,177 @@ void spdifAnalyzer::sample_callback( uint64_t t, uint64_t tend, enum SpdifFrameT
     frame.mStartingSampleInclusive = t+1;
     frame.mEndingSampleInclusive = tend;
     frame.mType = ft;
-    mResults->AddFrame( frame );
+
+    switch ( mSettings->mFrameMode )
+    {
+        case sfm_stereo:
+            AddStereo( frame );
+            break;
+
+        case sfm_block:
+            AddToBlock( t, tend, ft, aud_sample, gap || (flags & (SPDIF_SF_PARITY | SPDIF_SF_SUSPECT)) );
+            break;
+
+        default:
+            EmitFrame( frame );
+            break;
+    }
 
     mPrevSample = t;
     mPrevSampleEnd = tend;
-    mResults->CommitResults();
-    ReportProgress( t );
+}
+
+/* pair each left (B or M) subframe with the right (W) one after it, a lone subframe keeps a frame of its own */
+void spdifAnalyzer::AddStereo( Frame &sub )
+{
+    if ( sft_W != sub.mType ) {
+        FlushLeft();
+        mLeft = sub;
+        mHaveLeft = true;
+        return;
+    }
+
+    if ( !mHaveLeft ) {
+        EmitFrame( sub );
+        return;
+    }
+
+    Frame frame;
+
+    frame.mData1 = mLeft.mData2;
+    frame.mData2 = sub.mData2;
+    frame.mFlags = ( sft_B == mLeft.mType ) ? SPDIF_FRAME_FLAG_B : 0;
+    frame.mStartingSampleInclusive = mLeft.mStartingSampleInclusive;
+    frame.mEndingSampleInclusive = sub.mEndingSampleInclusive;
+    frame.mType = SPDIF_FT_STEREO;
+    EmitFrame( frame );
+
+    mHaveLeft = false;
+}
+
+void spdifAnalyzer::FlushLeft()
+{
+    if ( mHaveLeft ) {
+        mHaveLeft = false;
+        EmitFrame( mLeft );
+    }
+}
+
+/*
+ *  With repeats merged, a subframe (or stereo frame) that matches the one
+ *  before but for the ignored bits only adds to its count.  The subframes of
+ *  a run take turns left and right, as SpdifRunFrameType() gives them back.
+ *  Runs end with the block, so every block is shown as soon as it is decoded.
+ */
+void spdifAnalyzer::EmitFrame( Frame &frame )
+{
+    if ( !mSettings->mRunLength ) {
+        mResults->AddFrame( frame );
+        mFramesSinceCommit++;
+        return;
+    }
+
+    U32     mask = ~mSettings->mRunIgnoreMask;
+
+    if ( mRunCount &&
+         ((SPDIF_FT_STEREO == frame.mType) ?
+              ((SPDIF_FT_STEREO == mRun.mType) && !(frame.mFlags & SPDIF_FRAME_FLAG_B) &&
+               !(((U32) frame.mData1 ^ (U32) mRun.mData1) & mask)) :
+              ((SPDIF_FT_STEREO != mRun.mType) &&
+               (frame.mType == SpdifRunFrameType( (enum SpdifFrameType) mRun.mType, mRunCount )))) &&
+         !(((U32) frame.mData2 ^ (U32) mRun.mData2) & mask) ) {
+        mRun.mEndingSampleInclusive = frame.mEndingSampleInclusive;
+        mRunCount++;
+        return;
+    }
+
+    FlushRun();
+    mRun = frame;
+    mRunCount = 1;
+}
+
+void spdifAnalyzer::FlushRun()
+{
+    if ( !mRunCount )
+        return;
+
+    if ( mRunCount > 1 ) {
+        mRun.mType |= SPDIF_FT_RUN;
+        mRun.mData2 = (U32) mRun.mData2 | ((U64) mRunCount << 32);
+    }
+    mResults->AddFrame( mRun );
+    mFramesSinceCommit++;
+
+    mRunCount = 0;
+}
+
+/*
+ *  A block frame runs from a B subframe up to the next one, so it is only
+ *  added once that next B has been decoded.  Anything before the first B
+ *  makes a short block of its own.
+ */
+void spdifAnalyzer::AddToBlock( uint64_t t, uint64_t tend, enum SpdifFrameType ft, uint32_t aud_sample, bool error )
+{
+    int     pcm = SPDIF_PCM16( aud_sample );
+    int     side = ( sft_W == ft );
+
+    if ( sft_B == ft )
+        FlushBlock();
+
+    if ( !mBlockOpen ) {
+        mBlockOpen = true;
+        mBlockStart = t;
+        mBlockSubframes = 0;
+        mBlockErrors = 0;
+        mBlockHash = 2166136261U;               /* FNV-1a offset basis */
+        mBlockPeak[0] = mBlockPeak[1] = 0;
+    }
+
+    if ( pcm < 0 )
+        pcm = -pcm;
+    if ( pcm > mBlockPeak[side] )
+        mBlockPeak[side] = (U16) pcm;
+
+    /* FNV-1a over the channel status bits, in the order they were sent */
+    mBlockHash = (mBlockHash ^ ((aud_sample >> 30) & 1)) * 16777619U;
+
+    if ( error )
+        mBlockErrors++;
+
+    mBlockSubframes++;
+    mBlockEnd = tend;
+}
+
+void spdifAnalyzer::FlushBlock()
+{
+    if ( !mBlockOpen )
+        return;
+
+    Frame frame;
+
+    frame.mData1 = mBlockPeak[0] | ((U64) mBlockPeak[1] << 16) | ((U64) mBlockSubframes << 32);
+    frame.mData2 = mBlockHash | ((U64) mBlockErrors << 32);
+    frame.mFlags = ( mBlockErrors || (384 != mBlockSubframes) ) ? DISPLAY_AS_ERROR_FLAG : 0;
+    frame.mStartingSampleInclusive = mBlockStart+1;
+    frame.mEndingSampleInclusive = mBlockEnd;
+    frame.mType = SPDIF_FT_BLOCK;
+    mResults->AddFrame( frame );
+    mFramesSinceCommit++;
+
+    mBlockOpen = false;
 }
 
 void spdifAnalyzer::status_callback( uint64_t t, uint64_t tend, struct SpdifChannelStatus *status )
 {
+    /* the packet gets every frame of the block that just ended */
+    FlushLeft();
+    FlushRun();
+    FlushBlock();
+
     // we data to save
     if ( mPrevStatus ) {
         mResults->CommitPacketAndStartNewPacket();
-        mResults->CommitResults();
+        CommitPending( true );  /* a block at a time at the least */
     }
     mPrevStatus = t;
     mPrevStatusEnd = tend;
@@ -32,10 +32,110 @@
 
 extern "C" {
 #include <stdint.h>
+#include <stddef.h>
 #include "spdif.h"
 #include "wavhdr.h"
 };
 
+#include "spdifDecoder.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+/* number of edges collected in WorkerThread before they are handed to the decoder */
+#define SPDIF_EDGE_BATCH    1024
+
+/* edges the decoder computes its thresholds over */
+#define SPDIF_WINDOW_EDGES  (SPDIF_ANALYZER_SAMPLE_EDGES<<1)
+
+/*
+ *  Highest sample rate decoded with 8-bit edge widths.  A 32 kHz stream has
+ *  the longest cells S/PDIF uses (128 per frame), at this rate they are 64
+ *  samples and the 3-cell preamble pulse still fits a byte with room to spare.
+ */
+#define SPDIF_NARROW_DT_MAX_RATE    (32000ULL*128*64)
+
+/* frames added before they are committed, even if no block has ended and the latency allows */
+#define SPDIF_COMMIT_FRAMES 4096
+
+/* edges an overview probe searches for a B preamble before giving up, two blocks of all-ones data */
+#define SPDIF_OVERVIEW_SEARCH_EDGES     (384*64*2)
+
+/* edge batches in flight between WorkerThread() and the decode thread */
+#define SPDIF_PIPE_DEPTH    16
+
+/*
+ *  Subframes one batch can complete: each takes at least 32 edges and the
+ *  decoder never holds back more than a window of them from earlier batches.
+ */
+#define SPDIF_PIPE_SUBFRAMES    ((SPDIF_EDGE_BATCH + SPDIF_WINDOW_EDGES) >> 5)
+
+/*
+ *  Frame::mType of the frames that stand for more than one subframe, past the
+ *  enum SpdifFrameType values a single subframe frame carries.
+ *
+ *  stereo: mData1/mData2 are the left/right raw subframes
+ *  block:  mData1 = peak |PCM| left (bits 0-15), right (16-31), subframes (32-63)
+ *          mData2 = channel status hash (bits 0-31), errors (32-63)
+ *
+ *  A gap between subframes is an sft_invalid frame, mData1 = its length and
+ *  mData2 = how long sync was lost for when the subframe after it relocked.
+ */
+#define SPDIF_FT_STEREO     0x10
+#define SPDIF_FT_BLOCK      0x20
+
+/*
+ *  Frame::mType bit, the frame is a run of repeats of the subframe (or stereo
+ *  frame) it holds, counted in mData2 bits 32-63.  Bits the run ignores are
+ *  as the first subframe had them.
+ */
+#define SPDIF_FT_RUN        0x40
+
+/* Frame::mFlags, the stereo frame starts a block */
+#define SPDIF_FRAME_FLAG_B  0x01
+
+/* signed 16-bit PCM, the top of the 20/24-bit sample a raw subframe carries */
+#define SPDIF_PCM16( raw )  ((S16)((int)((uint32_t)(raw) << 4) >> 16))
+
+/* one batch of edges on its way through the pipeline, and what was decoded from it */
+struct spdifPipeSlot
+{
+    bool                        restart;        /* the decoder starts over before these edges ... */
+    uint64_t                    restart_time;   /* ... the first of which starts here */
+    uint32_t                    edge_dt[ SPDIF_EDGE_BATCH ];
+    size_t                      n_edges;
+
+    uint64_t                    t_start[ SPDIF_PIPE_SUBFRAMES ];
+    uint64_t                    t_end[ SPDIF_PIPE_SUBFRAMES ];
+    unsigned char               type[ SPDIF_PIPE_SUBFRAMES ];
+    uint32_t                    raw[ SPDIF_PIPE_SUBFRAMES ];
+    unsigned char               flags[ SPDIF_PIPE_SUBFRAMES ];
+    uint64_t                    lost[ SPDIF_PIPE_SUBFRAMES ];   /* with SPDIF_SF_RELOCK, samples sync was lost for */
+    struct SpdifSubframeBuffer  out;    /* over the arrays above, but lost[] */
+};
+
+/* the subframe writer the decode thread runs, also keeps how long each relock took */
+struct spdifRelockWriter : public SpdifSubframeWriter
+{
+    uint64_t                   *lost;       /* one per subframe of buf */
+    uint64_t                    lost_ticks; /* of the last relock_callback() */
+
+    void sample_callback( uint64_t t, uint64_t tend, enum SpdifFrameType ft, uint32_t aud_sample )
+    {
+        if ( relocked && (buf->count < buf->capacity) )
+            lost[ buf->count ] = lost_ticks;
+
+        SpdifSubframeWriter::sample_callback( t, tend, ft, aud_sample );
+    }
+
+    void relock_callback( uint64_t t, uint64_t tend, uint32_t nedges )
+    {
+        SpdifSubframeWriter::relock_callback( t, tend, nedges );
+        lost_ticks = tend - t;
+    }
+};
+
 class spdifAnalyzerSettings;
 class ANALYZER_EXPORT spdifAnalyzer : public Analyzer2
 {
@@ -51,10 +151,29 @@ public:
 	virtual bool NeedsRerun();
     virtual void SetupResults();
 
-    /* callbacks from the "C" bitstream analyzer library */
-    void sample_callback( uint64_t t, uint64_t tend, enum SpdifFrameType ft, uint32_t aud_sample );
+    /* decode stage, runs on its own thread */
+    void DecodeThread();
+    template <class Decoder> void DecodeSlots( Decoder &dec );
+    void StopDecodeThread();
+
+    /* overview frames, instead of the pipeline */
+    template <class Decoder> void OverviewProbes( Decoder &dec, U64 prev_edge );
+
+    /* result stage, runs on the WorkerThread() */
+    void DrainResults();
+    void CommitPending( bool force );
+
+    void sample_callback( uint64_t t, uint64_t tend, enum SpdifFrameType ft, uint32_t aud_sample, unsigned char flags, uint64_t lost );
     void status_callback( uint64_t t, uint64_t tend, struct SpdifChannelStatus *status );
 
+    /* frame granularity, see mSettings->mFrameMode */
+    void AddStereo( Frame &sub );
+    void AddToBlock( uint64_t t, uint64_t tend, enum SpdifFrameType ft, uint32_t aud_sample, bool error );
+    void FlushLeft();
+    void FlushBlock();
+    void EmitFrame( Frame &frame );
+    void FlushRun();
+
 protected: //vars
 	std::auto_ptr< spdifAnalyzerSettings > mSettings;
 	std::auto_ptr< spdifAnalyzerResults > mResults;
@@ -72,13 +191,55 @@ protected: //vars
 	U16 m_Pad0;
 	U32 m_AC3_Detected;	/* number of times AC3 frame headers have been noticed */
 
-    /* "C" bitstream parser library */
-    struct SpdifBitstreamAnalyzer *mSba;
+    /* bitstream decoders, the decode thread runs the one that fits the sample rate */
+    SpdifDecoder<uint8_t,SPDIF_WINDOW_EDGES,spdifRelockWriter>      mDecoder8;
+    SpdifDecoder<uint16_t,SPDIF_WINDOW_EDGES,spdifRelockWriter>     mDecoder16;
+    spdifRelockWriter              mWriter;
+    bool                           mNarrowDt;
+
+    /*
+     *  Slots pass through fetch (WorkerThread), decode (mDecodeThread) and
+     *  drain (WorkerThread again) in ring order.  Each cursor counts slots
+     *  and is only written by its own stage.
+     */
+    spdifPipeSlot                  mPipe[ SPDIF_PIPE_DEPTH ];
+    std::atomic<uint64_t>          mPipeFetched;
+    std::atomic<uint64_t>          mPipeDecoded;
+    uint64_t                       mPipeDrained;
+    std::atomic<bool>              mPipeStop;
+    std::thread                    mDecodeThread;
+
+    uint64_t                       mLastBStart;
+
+    /* every edge fetched, when mSettings->mTraceEdges is set */
+    struct SpdifTraceWriter       *mTrace;
+
+    /* frames added since the last CommitResults(), and when that was */
+    U32                            mFramesSinceCommit;
+    std::chrono::steady_clock::time_point   mLastCommit;
     uint64_t                       mSamplesSinceLastBSync;
+    U32                            mBlocksSinceHeartbeat;
     uint64_t                       mPrevSample;
     uint64_t                       mPrevSampleEnd;
     uint64_t                       mPrevStatus;
     uint64_t                       mPrevStatusEnd;
+
+    /* stereo frames, the left subframe waiting for its right */
+    Frame                          mLeft;
+    bool                           mHaveLeft;
+
+    /* run-length frames, the run being counted */
+    Frame                          mRun;
+    U32                            mRunCount;
+
+    /* block frames, the block being summarised */
+    bool                           mBlockOpen;
+    uint64_t                       mBlockStart;
+    uint64_t                       mBlockEnd;
+    U32                            mBlockSubframes;
+    U32                            mBlockErrors;
+    U32                            mBlockHash;
+    U16                            mBlockPeak[2];
 };
 
 extern "C" ANALYZER_EXPORT const char* __cdecl GetAnalyzerName();
@@ -29,6 +29,16 @@
 #include "spdifAnalyzerSettings.h"
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <string.h>
+
+/* frames the csv export formats in one piece, a worker thread takes a piece at a time */
+#define SPDIF_EXPORT_CHUNK_FRAMES   (1<<16)
+
+/* most worker threads the csv export formats with */
+#define SPDIF_EXPORT_MAX_THREADS    8
 
 spdifAnalyzerResults::spdifAnalyzerResults( spdifAnalyzer* analyzer, spdifAnalyzerSettings* settings )
 :	AnalyzerResults(),
@@ -41,77 +51,358 @@ spdifAnalyzerResults::~spdifAnalyzerResults()
 {
 }
 
+/* a 16-bit PCM value, signed in decimal */
+static void pcm_string( int pcm, DisplayBase display_base, char *str, U32 len )
+{
+    if ( (Decimal == display_base) || (ASCII == display_base) ) {
+        snprintf( str, len, "%d", pcm );
+    } else {
+        AnalyzerHelpers::GetNumberString( pcm & 0x0000ffff, display_base, 16, str, len );
+    }
+}
+
+/* subframes (or stereo frames) a frame stands for, and its type without the run bit */
+static U64 frame_repeats( Frame &frame )
+{
+    if ( !(frame.mType & SPDIF_FT_RUN) )
+        return 1;
+
+    frame.mType &= ~SPDIF_FT_RUN;
+    return frame.mData2 >> 32;
+}
+
 void spdifAnalyzerResults::GenerateBubbleText( U64 frame_index, Channel& channel, DisplayBase display_base )
 {
 	ClearResultStrings();
 	Frame frame = GetFrame( frame_index );
 
 	char num1_str[128];
+	char num2_str[128];
+	char text[300];
+	U64 repeats = frame_repeats( frame );
+
+    if ( sft_invalid == frame.mType ) {
+        if ( frame.mData2 ) {                               /* the decoder lost sync here */
+            AddResultString( "relock" );
+            snprintf( num1_str, sizeof(num1_str), "relock, lost %llu", (unsigned long long)frame.mData2 );
+            AddResultString( num1_str );
+        }
+        return;
+    }
 
-    if ( sft_invalid == frame.mType )
+    if ( SPDIF_FT_STEREO == frame.mType ) {
+        pcm_string( SPDIF_PCM16( frame.mData1 ), display_base, num1_str, sizeof(num1_str) );
+        pcm_string( SPDIF_PCM16( frame.mData2 ), display_base, num2_str, sizeof(num2_str) );
+        AddResultString( num1_str );
+        if ( repeats > 1 ) {
+            snprintf( text, sizeof(text), "L %s R %s x%llu", num1_str, num2_str, (unsigned long long)repeats );
+        } else {
+            snprintf( text, sizeof(text), "L %s R %s", num1_str, num2_str );
+        }
+        AddResultString( text );
         return;
+    }
 
-    if ( (Decimal == display_base) || (ASCII == display_base) ) {
-        snprintf( num1_str, sizeof(num1_str), "%d", (int)frame.mData1 );
-    } else {
-        AnalyzerHelpers::GetNumberString( frame.mData1 & 0x0000ffff, display_base, 16, num1_str, 128 );
+    if ( SPDIF_FT_BLOCK == frame.mType ) {
+        pcm_string( (U16) frame.mData1, display_base, num1_str, sizeof(num1_str) );
+        pcm_string( (U16)( frame.mData1 >> 16 ), display_base, num2_str, sizeof(num2_str) );
+        snprintf( text, sizeof(text), "%u err", (unsigned)( frame.mData2 >> 32 ) );
+        AddResultString( text );
+        snprintf( text, sizeof(text), "peak %s/%s, %u err", num1_str, num2_str, (unsigned)( frame.mData2 >> 32 ) );
+        AddResultString( text );
+        snprintf( text, sizeof(text), "%u subframes, peak %s/%s, %u errors, status %08x",
+                  (unsigned)( frame.mData1 >> 32 ), num1_str, num2_str,
+                  (unsigned)( frame.mData2 >> 32 ), (unsigned)frame.mData2 );
+        AddResultString( text );
+        return;
     }
 
+    pcm_string( (int)frame.mData1, display_base, num1_str, sizeof(num1_str) );
     AddResultString( num1_str );
+
+    if ( repeats > 1 ) {
+        snprintf( text, sizeof(text), "%s x%llu", num1_str, (unsigned long long)repeats );
+        AddResultString( text );
+    }
 }
 
-void spdifAnalyzerResults::GenerateExportFile( const char* file, DisplayBase display_base, U32 export_type_user_id )
+/* what a csv row needs besides its frame */
+struct spdifCsvFormat
 {
-    if ( 0 == export_type_user_id ) /* text/csv */
+    DisplayBase     display_base;
+    U32             frame_mode;
+    U64             trigger_sample;
+    U32             sample_rate;
+};
+
+/*
+ *  The csv export formats rows itself, the SDK's string helpers take a
+ *  round trip through a stack buffer and printf per number.
+ */
+static char *csv_u64( char *p, U64 v )
+{
+    char    digits[20];
+    int     n = 0;
+
+    do
+    {
+        digits[n++] = (char)('0' + (v % 10));
+        v /= 10;
+    }
+    while ( v );
+
+    while ( n )
+        *p++ = digits[--n];
+
+    return p;
+}
+
+/* seconds from the trigger to the nanosecond, in integers so it is exact and quick */
+static char *csv_time( char *p, U64 sample, const spdifCsvFormat &f )
+{
+    U64     d;
+    U64     ns;
+    int     i;
+
+    if ( sample < f.trigger_sample )
+    {
+        *p++ = '-';
+        d = f.trigger_sample - sample;
+    }
+    else
+    {
+        d = sample - f.trigger_sample;
+    }
+
+    p = csv_u64( p, d / f.sample_rate );
+    *p++ = '.';
+
+    ns = (d % f.sample_rate) * 1000000000ULL / f.sample_rate;
+    for ( i = 8; i >= 0; i-- )
     {
-        std::ofstream file_stream( file, std::ios::out );
+        p[i] = (char)('0' + (ns % 10));
+        ns /= 10;
+    }
 
-    	U64 trigger_sample = mAnalyzer->GetTriggerSample();
-    	U32 sample_rate = mAnalyzer->GetSampleRate();
+    return p + 9;
+}
 
-    	file_stream << "Time [s],Value" << std::endl;
+/*
+ *  The low bits of v in binary or hex, every digit, as the SDK shows them.
+ *  The SDK helpers are not safe to call from the export workers.
+ */
+static char *csv_digits( char *p, U64 v, U32 bits, const spdifCsvFormat &f )
+{
+    static const char   digit[] = "0123456789ABCDEF";
+    U32                 shift = ( Binary == f.display_base ) ? 1 : 4;
+    U32                 n = (bits + shift - 1) / shift;
 
-    	U64 num_frames = GetNumFrames();
-    	for( U32 i=0; i < num_frames; i++ )
-    	{
-    		Frame frame = GetFrame( i );
-    		
-    		char time_str[128];
-    		AnalyzerHelpers::GetTimeString( frame.mStartingSampleInclusive, trigger_sample, sample_rate, time_str, 128 );
+    *p++ = '0';
+    *p++ = ( 1 == shift ) ? 'b' : 'x';
 
-    		char number_str[128];
-    		AnalyzerHelpers::GetNumberString( frame.mData1, display_base, 8, number_str, 128 );
+    while ( n-- )
+        *p++ = digit[ (v >> (n * shift)) & ((1 << shift) - 1) ];
 
-    		file_stream << time_str << "," << number_str << std::endl;
+    return p;
+}
 
-    		if( UpdateExportProgressAndCheckForCancel( i, num_frames ) == true )
-    		{
-                break;
-    		}
-    	}
-        file_stream.close();
+/* a PCM value as the bubbles show it, signed in decimal */
+static char *csv_pcm( char *p, int pcm, const spdifCsvFormat &f )
+{
+    if ( (Decimal == f.display_base) || (ASCII == f.display_base) )
+    {
+        if ( pcm < 0 )
+        {
+            *p++ = '-';
+            return csv_u64( p, (U64)(-(S64) pcm) );
+        }
+        return csv_u64( p, (U64) pcm );
     }
-    else if ( 1 == export_type_user_id ) /* wav */
+
+    return csv_digits( p, pcm & 0x0000ffff, 16, f );
+}
+
+static char *csv_number( char *p, U64 v, U32 bits, const spdifCsvFormat &f )
+{
+    if ( (Decimal == f.display_base) || (ASCII == f.display_base) )
+        return csv_u64( p, v );
+
+    return csv_digits( p, v, bits, f );
+}
+
+/* the rows for frames[], a run gets a row per repeat spread evenly over it */
+static void csv_rows( const std::vector<Frame> &frames, std::string &text, const spdifCsvFormat &f )
+{
+    char    row[512];
+
+    text.clear();
+    text.reserve( frames.size() * 32 );
+
+    for ( size_t i = 0; i < frames.size(); i++ )
     {
-        std::ofstream file_stream( file, std::ios::binary );
+        Frame   frame = frames[i];
+        U64     repeats = frame_repeats( frame );
+        U64     span = frame.mEndingSampleInclusive + 1 - frame.mStartingSampleInclusive;
 
-        struct WAVHeader     wh;
-        U64                  num_frames = GetNumFrames();
-        U64                  num_samples = 0;
+        for ( U64 k = 0; k < repeats; k++ )
+        {
+            char    *p = csv_time( row, frame.mStartingSampleInclusive + span * k / repeats, f );
+            U8      type = ( frame.mType < SPDIF_FT_STEREO ) ?
+                           (U8) SpdifRunFrameType( (enum SpdifFrameType) frame.mType, k ) : frame.mType;
 
-        wh_Init( &wh, (uint32_t) num_frames>>1 );
+            *p++ = ',';
 
-        file_stream.write((const char *)&wh,sizeof(wh));
+            if ( SPDIF_FT_STEREO == frame.mType )
+            {
+                p = csv_pcm( p, SPDIF_PCM16( frame.mData1 ), f );
+                *p++ = ',';
+                p = csv_pcm( p, SPDIF_PCM16( frame.mData2 ), f );
+            }
+            else if ( SPDIF_FT_BLOCK == frame.mType )
+            {
+                p = csv_u64( p, frame.mData1 >> 32 );
+                *p++ = ',';
+                p = csv_u64( p, frame.mData1 & 0xffff );
+                *p++ = ',';
+                p = csv_u64( p, (frame.mData1 >> 16) & 0xffff );
+                *p++ = ',';
+                p = csv_u64( p, frame.mData2 >> 32 );
+                *p++ = ',';
+                p = csv_number( p, (U32) frame.mData2, 32, f );
+            }
+            else if ( sft_invalid == frame.mType )
+            {
+                p = csv_number( p, frame.mData1, 32, f );      /* gap length */
+            }
+            else if ( (sfm_stereo == f.frame_mode) || (sfm_overview == f.frame_mode) )
+            {
+                /* a subframe without its other half, in its own column */
+                if ( sft_W == type )
+                    *p++ = ',';
+                p = csv_pcm( p, (int) frame.mData1, f );
+                if ( sft_W != type )
+                    *p++ = ',';
+            }
+            else
+            {
+                p = csv_pcm( p, (int) frame.mData1, f );
+            }
+
+            *p++ = '\n';
+            text.append( row, p - row );
+        }
+    }
+}
+
+/*
+ *  Frames are fetched on this thread a chunk per worker, formatted in
+ *  parallel, then written in order.  Rows go out a chunk at a time rather
+ *  than a flush per line.
+ */
+void spdifAnalyzerResults::ExportCsv( const char* file, DisplayBase display_base )
+{
+    std::ofstream   file_stream( file, std::ios::out );
+    spdifCsvFormat  f;
+    unsigned int    nthreads = std::thread::hardware_concurrency();
+    U64             num_frames = GetNumFrames();
+    U64             first = 0;
+
+    f.display_base = display_base;
+    f.frame_mode = mSettings->mFrameMode;
+    f.trigger_sample = mAnalyzer->GetTriggerSample();
+    f.sample_rate = mAnalyzer->GetSampleRate();
+    if ( 0 == f.sample_rate )
+        f.sample_rate = 1;
+
+    if ( 0 == nthreads )
+        nthreads = 1;
+    if ( nthreads > SPDIF_EXPORT_MAX_THREADS )
+        nthreads = SPDIF_EXPORT_MAX_THREADS;
+
+    if ( (sfm_stereo == f.frame_mode) || (sfm_overview == f.frame_mode) )
+        file_stream << "Time [s],Left,Right\n";
+    else if ( sfm_block == f.frame_mode )
+        file_stream << "Time [s],Subframes,Peak left,Peak right,Errors,Status hash\n";
+    else
+        file_stream << "Time [s],Value\n";
+
+    std::vector< std::vector<Frame> >   frames( nthreads );
+    std::vector< std::string >          text( nthreads );
+
+    while ( first < num_frames )
+    {
+        std::vector< std::thread >  workers;
+        unsigned int                n,k;
+
+        for ( n = 0; (n < nthreads) && (first < num_frames); n++ )
+        {
+            U64     count = num_frames - first;
+
+            if ( count > SPDIF_EXPORT_CHUNK_FRAMES )
+                count = SPDIF_EXPORT_CHUNK_FRAMES;
+
+            frames[n].resize( (size_t) count );
+            for ( U64 i = 0; i < count; i++ )
+                frames[n][(size_t) i] = GetFrame( first + i );
+
+            first += count;
+        }
+
+        for ( k = 1; k < n; k++ )
+            workers.push_back( std::thread( csv_rows, std::cref( frames[k] ), std::ref( text[k] ), std::cref( f ) ) );
+
+        csv_rows( frames[0], text[0], f );
+
+        for ( k = 0; k < workers.size(); k++ )
+            workers[k].join();
+
+        for ( k = 0; k < n; k++ )
+            file_stream.write( text[k].data(), text[k].size() );
+
+        if ( UpdateExportProgressAndCheckForCancel( first, num_frames ) == true )
+        {
+            break;
+        }
+    }
+
+    file_stream.close();
+}
+
+void spdifAnalyzerResults::GenerateExportFile( const char* file, DisplayBase display_base, U32 export_type_user_id )
+{
+    if ( 0 == export_type_user_id ) /* text/csv */
+    {
+        ExportCsv( file, display_base );
+    }
+    else if ( 1 == export_type_user_id ) /* wav */
+    {
+        struct SpdifWavWriter *wav = SpdifWavWriter_Open( file, 48000, mSettings->mWavBits );
+        U64                  num_frames = GetNumFrames();
+        U64                  subframes = 0;
+        U64                  ticks = 0;
+
+        if ( NULL == wav )
+            return;
 
-        for( U32 i=0; i < num_frames; i++ )
+        for( U64 i=0; i < num_frames; i++ )
         {
             Frame frame = GetFrame( i );
+            U64   repeats = frame_repeats( frame );
             
-            if ( ! (0x80 & frame.mType) ) /* general errors are not PCM */
+            if ( SPDIF_FT_STEREO == frame.mType )
+            {
+                SpdifWavWriter_Stereo( wav, (uint32_t) frame.mData1, (uint32_t) frame.mData2, repeats );
+                subframes += 2 * repeats;
+                ticks += frame.mEndingSampleInclusive + 1 - frame.mStartingSampleInclusive;
+            }
+            else if ( SPDIF_FT_BLOCK == frame.mType ) /* summaries carry no audio */
+            {
+            }
+            else if ( (sft_invalid != frame.mType) && ! (0x80 & frame.mType) ) /* gaps and general errors are not PCM */
             {
-                uint16_t pcm = (uint16_t) frame.mData1;
-                file_stream.write((const char *)&pcm,sizeof(pcm));
-                num_samples++;
+                SpdifWavWriter_Run( wav, (enum SpdifFrameType) frame.mType, (uint32_t) frame.mData2, repeats );
+                subframes += repeats;
+                ticks += frame.mEndingSampleInclusive + 1 - frame.mStartingSampleInclusive;
             }
 
             if( UpdateExportProgressAndCheckForCancel( i, num_frames ) == true )
@@ -120,10 +411,11 @@ void spdifAnalyzerResults::GenerateExportFile( const char* file, DisplayBase dis
             }
         }
 
-        wh_Init( &wh, (uint32_t) num_samples>>1 );
-        file_stream.seekp(0);
-        file_stream.write((const char *)&wh,sizeof(wh));
-        file_stream.close();
+        /* the audio rate, from how long the subframes took */
+        if ( 0 != ticks )
+            SpdifWavWriter_SetRate( wav, SpdifNominalRate( subframes, 2 * ticks, mAnalyzer->GetSampleRate() ) );
+
+        SpdifWavWriter_Close( wav );
     }
     else if ( 2 == export_type_user_id ) /* raw/bin */
     {
@@ -131,15 +423,29 @@ void spdifAnalyzerResults::GenerateExportFile( const char* file, DisplayBase dis
 
         U64                  num_frames = GetNumFrames();
 
-        for( U32 i=0; i < num_frames; i++ )
+        for( U64 i=0; i < num_frames; i++ )
         {
             Frame frame = GetFrame( i );
+            U64   repeats = frame_repeats( frame );
             
-            if ( ! (0x80 & frame.mType) ) /* general errors are not data */
+            if ( SPDIF_FT_STEREO == frame.mType )
+            {
+                uint32_t raw[2];
+
+                raw[0] = (uint32_t) frame.mData1;
+                raw[1] = (uint32_t) frame.mData2;
+                for ( U64 k = 0; k < repeats; k++ )
+                    file_stream.write((const char *)raw,sizeof(raw));
+            }
+            else if ( SPDIF_FT_BLOCK == frame.mType ) /* summaries carry no subframes */
+            {
+            }
+            else if ( ! (0x80 & frame.mType) ) /* general errors are not data */
             {
                 uint32_t raw = (uint32_t) frame.mData2;
 
-                file_stream.write((const char *)&raw,sizeof(raw));
+                for ( U64 k = 0; k < repeats; k++ )
+                    file_stream.write((const char *)&raw,sizeof(raw));
             }
 
             if( UpdateExportProgressAndCheckForCancel( i, num_frames ) == true )
@@ -157,9 +463,12 @@ void spdifAnalyzerResults::GenerateFrameTabularText( U64 frame_index, DisplayBas
 	Frame frame = GetFrame( frame_index );
     const char *frtype;
 
+    frame_repeats( frame );
+
 	ClearTabularText();
 
     char num1_str[128];
+    char num2_str[128];
 
     switch(frame.mType)
     {
@@ -182,7 +491,27 @@ void spdifAnalyzerResults::GenerateFrameTabularText( U64 frame_index, DisplayBas
             return;
         break;
 
+        case SPDIF_FT_STEREO:
+            frtype = ( frame.mFlags & SPDIF_FRAME_FLAG_B ) ? "T:BW" : "T:MW";
+            pcm_string( SPDIF_PCM16( frame.mData1 ), display_base, num1_str, sizeof(num1_str) );
+            pcm_string( SPDIF_PCM16( frame.mData2 ), display_base, num2_str, sizeof(num2_str) );
+            AddTabularText( frtype, " L:", num1_str, " R:", num2_str );
+            return;
+
+        case SPDIF_FT_BLOCK:
+            snprintf( num1_str, sizeof(num1_str), "%u", (unsigned)( frame.mData2 >> 32 ) );
+            AddTabularText( "T:block", " errors:", num1_str );
+            return;
+
         case sft_invalid:
+            if ( frame.mData2 ) {
+                snprintf( num1_str, sizeof(num1_str), "%llu", (unsigned long long)frame.mData2 );
+                AddTabularText( "T:relock", " lost:", num1_str );
+                return;
+            }
+            frtype = "T:err";
+        break;
+
         default:
             frtype = "T:err";
         break;
@@ -45,6 +45,7 @@ public:
 	virtual void GenerateTransactionTabularText( U64 transaction_id, DisplayBase display_base );
 
 protected: //functions
+	void ExportCsv( const char* file, DisplayBase display_base );
 
 protected:  //vars
 	spdifAnalyzerSettings* mSettings;
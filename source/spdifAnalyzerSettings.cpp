@@ -1,5 +1,7 @@
 #include "spdifAnalyzerSettings.h"
 #include <AnalyzerHelpers.h>
+#include <stdio.h>
+#include <stdlib.h>
 /* 
 
   GPL LICENSE SUMMARY
@@ -28,13 +30,86 @@
 
 
 spdifAnalyzerSettings::spdifAnalyzerSettings()
-:	mInputChannel( UNDEFINED_CHANNEL )
+:	mInputChannel( UNDEFINED_CHANNEL ),
+	mCommitLatencyMs( SPDIF_COMMIT_LATENCY_MS ),
+	mFrameMode( sfm_subframe ),
+	mOverviewBlocks( SPDIF_OVERVIEW_BLOCKS ),
+	mMarkerMode( smm_all ),
+	mRunLength( false ),
+	mRunIgnoreMask( SPDIF_RUN_IGNORE_MASK ),
+	mWavBits( SPDIF_WAV_BITS ),
+	mTraceEdges( false )
 {
 	mInputChannelInterface.reset( new AnalyzerSettingInterfaceChannel() );
 	mInputChannelInterface->SetTitleAndTooltip( "SPDIF", "Standard Pat's SPDIF" );
 	mInputChannelInterface->SetChannel( mInputChannel );
 
+	mCommitLatencyInterface.reset( new AnalyzerSettingInterfaceInteger() );
+	mCommitLatencyInterface->SetTitleAndTooltip( "Update latency (ms)", "Longest decoded frames are held back before being shown, longer is faster on big captures" );
+	mCommitLatencyInterface->SetMin( 1 );
+	mCommitLatencyInterface->SetMax( 10000 );
+	mCommitLatencyInterface->SetInteger( mCommitLatencyMs );
+
+	mFrameModeInterface.reset( new AnalyzerSettingInterfaceNumberList() );
+	mFrameModeInterface->SetTitleAndTooltip( "Frames", "What each decoded frame shows, fewer frames keep long captures in memory" );
+	mFrameModeInterface->AddNumber( sfm_subframe, "Subframe", "One frame per subframe, with its PCM value" );
+	mFrameModeInterface->AddNumber( sfm_stereo, "Stereo frame", "One frame per left/right pair" );
+	mFrameModeInterface->AddNumber( sfm_block, "Block", "One frame per 192 frame channel status block: peak levels, errors and a channel status hash" );
+	mFrameModeInterface->AddNumber( sfm_overview, "Overview", "Skim the capture, one stereo frame from a block now and then. Quick to check a long capture before decoding all of it" );
+	mFrameModeInterface->SetNumber( mFrameMode );
+
+	mOverviewBlocksInterface.reset( new AnalyzerSettingInterfaceInteger() );
+	mOverviewBlocksInterface->SetTitleAndTooltip( "Overview every (blocks)", "Blocks from one overview frame to the next, 250 blocks is a second of 48 kHz audio" );
+	mOverviewBlocksInterface->SetMin( 1 );
+	mOverviewBlocksInterface->SetMax( 1000000 );
+	mOverviewBlocksInterface->SetInteger( mOverviewBlocks );
+
+	mMarkerModeInterface.reset( new AnalyzerSettingInterfaceNumberList() );
+	mMarkerModeInterface->SetTitleAndTooltip( "Markers", "Which events are marked on the waveform" );
+	mMarkerModeInterface->AddNumber( smm_all, "All", "Every block start, AC3 sync and error" );
+	mMarkerModeInterface->AddNumber( smm_errors, "Errors only", "Gaps, out of sequence block starts, parity and sync errors" );
+	mMarkerModeInterface->AddNumber( smm_heartbeat, "Errors and heartbeat", "Errors, and a block start now and then to show the stream is alive" );
+	mMarkerModeInterface->SetNumber( mMarkerMode );
+
+	mRunLengthInterface.reset( new AnalyzerSettingInterfaceBool() );
+	mRunLengthInterface->SetTitleAndTooltip( "Repeats", "Subframes (or stereo frames) that repeat the one before share its frame, which counts them" );
+	mRunLengthInterface->SetCheckBoxText( "Merge repeated subframes" );
+	mRunLengthInterface->SetValue( mRunLength );
+
+	mRunIgnoreMaskInterface.reset( new AnalyzerSettingInterfaceText() );
+	mRunIgnoreMaskInterface->SetTitleAndTooltip( "Repeats ignore bits (hex)", "Subframe bits that may change within a repeat, 28 = V, 29 = U, 30 = C, 31 = parity" );
+
+	char mask[16];
+	snprintf( mask, sizeof(mask), "%08x", mRunIgnoreMask );
+	mRunIgnoreMaskInterface->SetText( mask );
+
+	mWavBitsInterface.reset( new AnalyzerSettingInterfaceNumberList() );
+	mWavBitsInterface->SetTitleAndTooltip( "WAV sample size", "Bits per sample in a WAV export, taken from the top of the 24 audio bits of each subframe" );
+	mWavBitsInterface->AddNumber( 16, "16 bit", "Subframe bits 12-27, as a CD carries" );
+	mWavBitsInterface->AddNumber( 20, "20 bit", "Subframe bits 8-27, in 24-bit samples" );
+	mWavBitsInterface->AddNumber( 24, "24 bit", "Subframe bits 4-27" );
+	mWavBitsInterface->SetNumber( mWavBits );
+
+	mTraceEdgesInterface.reset( new AnalyzerSettingInterfaceBool() );
+	mTraceEdgesInterface->SetTitleAndTooltip( "Edge trace", "Record every edge decoded to a compact trace file, which spdif_decode reads back. Much smaller than a CSV export, for bug reports and benchmarks" );
+	mTraceEdgesInterface->SetCheckBoxText( "Record edges" );
+	mTraceEdgesInterface->SetValue( mTraceEdges );
+
+	mTracePathInterface.reset( new AnalyzerSettingInterfaceText() );
+	mTracePathInterface->SetTitleAndTooltip( "Edge trace file", "Where the edges are recorded, it is written over on each run" );
+	mTracePathInterface->SetTextType( AnalyzerSettingInterfaceText::FilePath );
+	mTracePathInterface->SetText( mTracePath.c_str() );
+
 	AddInterface( mInputChannelInterface.get() );
+	AddInterface( mCommitLatencyInterface.get() );
+	AddInterface( mFrameModeInterface.get() );
+	AddInterface( mOverviewBlocksInterface.get() );
+	AddInterface( mMarkerModeInterface.get() );
+	AddInterface( mRunLengthInterface.get() );
+	AddInterface( mRunIgnoreMaskInterface.get() );
+	AddInterface( mWavBitsInterface.get() );
+	AddInterface( mTraceEdgesInterface.get() );
+	AddInterface( mTracePathInterface.get() );
 
 	AddExportOption( 0, "Export as text/csv file" );
 	AddExportExtension( 0, "text", "txt" );
@@ -57,7 +132,32 @@ spdifAnalyzerSettings::~spdifAnalyzerSettings()
 
 bool spdifAnalyzerSettings::SetSettingsFromInterfaces()
 {
+	const char *mask = mRunIgnoreMaskInterface->GetText();
+	char *end;
+	unsigned long run_ignore_mask = strtoul( mask, &end, 16 );
+
+	if ( (end == mask) || (*end != '\0') || (run_ignore_mask > 0xffffffffUL) )
+	{
+		SetErrorText( "Repeats ignore bits must be a hex number, such as e0000000" );
+		return false;
+	}
+
+	if ( mTraceEdgesInterface->GetValue() && ('\0' == *mTracePathInterface->GetText()) )
+	{
+		SetErrorText( "Choose a file to record the edge trace in" );
+		return false;
+	}
+
+	mRunIgnoreMask = (U32) run_ignore_mask;
+	mRunLength = mRunLengthInterface->GetValue();
 	mInputChannel = mInputChannelInterface->GetChannel();
+	mCommitLatencyMs = mCommitLatencyInterface->GetInteger();
+	mFrameMode = (U32) mFrameModeInterface->GetNumber();
+	mOverviewBlocks = mOverviewBlocksInterface->GetInteger();
+	mMarkerMode = (U32) mMarkerModeInterface->GetNumber();
+	mWavBits = (U32) mWavBitsInterface->GetNumber();
+	mTraceEdges = mTraceEdgesInterface->GetValue();
+	mTracePath = mTracePathInterface->GetText();
 
 	ClearChannels();
 	AddChannel( mInputChannel, "Pat's SPDIF analyzer", true );
@@ -68,6 +168,18 @@ bool spdifAnalyzerSettings::SetSettingsFromInterfaces()
 void spdifAnalyzerSettings::UpdateInterfacesFromSettings()
 {
 	mInputChannelInterface->SetChannel( mInputChannel );
+	mCommitLatencyInterface->SetInteger( mCommitLatencyMs );
+	mFrameModeInterface->SetNumber( mFrameMode );
+	mOverviewBlocksInterface->SetInteger( mOverviewBlocks );
+	mMarkerModeInterface->SetNumber( mMarkerMode );
+	mRunLengthInterface->SetValue( mRunLength );
+	mWavBitsInterface->SetNumber( mWavBits );
+	mTraceEdgesInterface->SetValue( mTraceEdges );
+	mTracePathInterface->SetText( mTracePath.c_str() );
+
+	char mask[16];
+	snprintf( mask, sizeof(mask), "%08x", mRunIgnoreMask );
+	mRunIgnoreMaskInterface->SetText( mask );
 }
 
 void spdifAnalyzerSettings::LoadSettings( const char* settings )
@@ -77,6 +189,40 @@ void spdifAnalyzerSettings::LoadSettings( const char* settings )
 
 	text_archive >> mInputChannel;
 
+	/* settings saved before there was a latency setting end here */
+	if ( !(text_archive >> mCommitLatencyMs) )
+		mCommitLatencyMs = SPDIF_COMMIT_LATENCY_MS;
+
+	if ( !(text_archive >> mFrameMode) || (mFrameMode > sfm_overview) )
+		mFrameMode = sfm_subframe;
+
+	if ( !(text_archive >> mMarkerMode) || (mMarkerMode > smm_heartbeat) )
+		mMarkerMode = smm_all;
+
+	if ( !(text_archive >> mRunLength) || !(text_archive >> mRunIgnoreMask) )
+	{
+		mRunLength = false;
+		mRunIgnoreMask = SPDIF_RUN_IGNORE_MASK;
+	}
+
+	if ( !(text_archive >> mOverviewBlocks) || (0 == mOverviewBlocks) )
+		mOverviewBlocks = SPDIF_OVERVIEW_BLOCKS;
+
+	if ( !(text_archive >> mWavBits) || ((16 != mWavBits) && (20 != mWavBits) && (24 != mWavBits)) )
+		mWavBits = SPDIF_WAV_BITS;
+
+	char const *trace_path;
+
+	if ( !(text_archive >> mTraceEdges) || !(text_archive >> &trace_path) )
+	{
+		mTraceEdges = false;
+		mTracePath.clear();
+	}
+	else
+	{
+		mTracePath = trace_path;
+	}
+
 	ClearChannels();
 	AddChannel( mInputChannel, "Pat's SPDIF analyzer", true );
 
@@ -88,6 +234,15 @@ const char* spdifAnalyzerSettings::SaveSettings()
 	SimpleArchive text_archive;
 
 	text_archive << mInputChannel;
+	text_archive << mCommitLatencyMs;
+	text_archive << mFrameMode;
+	text_archive << mMarkerMode;
+	text_archive << mRunLength;
+	text_archive << mRunIgnoreMask;
+	text_archive << mOverviewBlocks;
+	text_archive << mWavBits;
+	text_archive << mTraceEdges;
+	text_archive << mTracePath.c_str();
 
 	return SetReturnString( text_archive.GetString() );
 }
@@ -29,6 +29,40 @@
 #include <AnalyzerSettings.h>
 #include <AnalyzerTypes.h>
 
+#include <string>
+
+/* default for mCommitLatencyMs, often enough for a live capture to scroll smoothly */
+#define SPDIF_COMMIT_LATENCY_MS     50
+
+/* what one result Frame stands for, mFrameMode */
+enum SpdifFrameMode
+{
+    sfm_subframe,   /* every subframe, mData1 = PCM, mData2 = raw subframe */
+    sfm_stereo,     /* a left/right pair, mData1/mData2 = left/right raw subframes */
+    sfm_block,      /* a whole channel status block, summarised */
+    sfm_overview    /* the first stereo frame of every mOverviewBlocks'th block, skipping the rest */
+};
+
+/* default for mOverviewBlocks, a probe a second of 48 kHz audio */
+#define SPDIF_OVERVIEW_BLOCKS       250
+
+/* which markers are added, mMarkerMode */
+enum SpdifMarkerMode
+{
+    smm_all,        /* every B preamble, AC3 sync and error */
+    smm_errors,     /* gaps, out of sequence B preambles, parity and sync errors */
+    smm_heartbeat   /* errors, and a B preamble every SPDIF_HEARTBEAT_BLOCKS blocks */
+};
+
+/* blocks between heartbeat markers, a second of 48 kHz audio */
+#define SPDIF_HEARTBEAT_BLOCKS      250
+
+/* default for mWavBits, what a CD carries */
+#define SPDIF_WAV_BITS              16
+
+/* default for mRunIgnoreMask: the U and C bits, and parity which follows them */
+#define SPDIF_RUN_IGNORE_MASK       0xe0000000
+
 class spdifAnalyzerSettings : public AnalyzerSettings
 {
 public:
@@ -41,9 +75,27 @@ public:
 	virtual const char* SaveSettings();
 
 	Channel mInputChannel;
+	U32 mCommitLatencyMs;	/* longest decoded results wait before they are shown */
+	U32 mFrameMode;			/* enum SpdifFrameMode */
+	U32 mOverviewBlocks;	/* blocks from one overview probe to the next */
+	U32 mMarkerMode;		/* enum SpdifMarkerMode */
+	bool mRunLength;		/* repeated subframes share one frame */
+	U32 mRunIgnoreMask;		/* subframe bits that may differ within a run */
+	U32 mWavBits;			/* bits per sample in a WAV export, 16, 20 or 24 */
+	bool mTraceEdges;		/* record the edges decoded to mTracePath */
+	std::string mTracePath;	/* edge trace file, see SpdifTraceWriter */
 
 protected:
 	std::auto_ptr< AnalyzerSettingInterfaceChannel >	mInputChannelInterface;
+	std::auto_ptr< AnalyzerSettingInterfaceInteger >	mCommitLatencyInterface;
+	std::auto_ptr< AnalyzerSettingInterfaceNumberList >	mFrameModeInterface;
+	std::auto_ptr< AnalyzerSettingInterfaceInteger >	mOverviewBlocksInterface;
+	std::auto_ptr< AnalyzerSettingInterfaceNumberList >	mMarkerModeInterface;
+	std::auto_ptr< AnalyzerSettingInterfaceBool >		mRunLengthInterface;
+	std::auto_ptr< AnalyzerSettingInterfaceText >		mRunIgnoreMaskInterface;
+	std::auto_ptr< AnalyzerSettingInterfaceNumberList >	mWavBitsInterface;
+	std::auto_ptr< AnalyzerSettingInterfaceBool >		mTraceEdgesInterface;
+	std::auto_ptr< AnalyzerSettingInterfaceText >		mTracePathInterface;
 };
 
 #endif //SPDIF_ANALYZER_SETTINGS
@@ -0,0 +1,1645 @@
+#ifndef SPDIF_DECODER_H
+#define SPDIF_DECODER_H 1
+/*
+
+  GPL LICENSE SUMMARY
+
+  Copyright(c) Pat Brouillette. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of version 2 of the GNU General Public License as
+  published by the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+  The full GNU General Public License is included in this distribution
+  in the file called LICENSE.GPL.
+
+  Contact Information:
+    Pat Brouillette  pfrench@acm.org
+
+*/
+
+/*
+ *  S/PDIF bitstream decoder core.
+ *
+ *  SpdifDecoder<Dt,WindowEdges,Sink> is specialized on the type the edge widths are
+ *  kept in and on the number of edges the thresholds are computed over.  At the
+ *  usual oversampling (25 MHz capture of a 48 kHz stream is ~4 ticks per cell)
+ *  every width fits a byte, and a uint8_t ring classifies twice the edges per
+ *  vector.  Widths too long for Dt are saturated, the excess is kept aside so
+ *  edge times stay exact.
+ *
+ *  Decoded data goes to a Sink, any class with
+ *
+ *      void sample_callback( uint64_t t, uint64_t tend, enum SpdifFrameType ft, uint32_t aud_sample );
+ *      void status_callback( uint64_t t, uint64_t tend, struct SpdifChannelStatus *status );
+ *      void relock_callback( uint64_t t, uint64_t tend, uint32_t nedges );
+ *      void suspect_callback( uint64_t t, uint64_t tend );
+ *
+ *  called directly, so they inline into the decode loop when the sink's
+ *  definitions are visible.  The "C" API in spdif.cpp is a 16-bit instance
+ *  with a sink that calls through SpdifBitstreamCallbacks.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SBA_CLASSIFY_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define SBA_CLASSIFY_SSE2
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+#include <intrin.h>
+#endif
+
+/* with a popcount instruction the edges of a word are taken 4 at a time, see SpdifBitEdges */
+#if defined(__POPCNT__) || (defined(_MSC_VER) && defined(_M_X64) && defined(__AVX2__))
+#define SBA_EDGES_POPCNT
+#endif
+
+#include "spdif.h"
+
+/* most edges a subframe can take (32 bits, 2 edges per 1 bit) */
+#define SPDIF_ANALYZER_SAMPLE_EDGES (1<<6)
+
+/* running min/max of dt is kept per block of edges, see TrackEdge() */
+#define SBA_BLOCK_SHIFT     4
+#define SBA_BLOCK_EDGES     (1<<SBA_BLOCK_SHIFT)
+#define SBA_BLOCK_MASK      (SBA_BLOCK_EDGES-1)
+
+/*
+ *  Each edge is classified against the current thresholds before the preamble
+ *  and bit logic look at it.  An edge exactly on threshold_12 gets its own symbol
+ *  so the classified decode makes the very same decisions as the raw compares.
+ */
+#define SBA_SYM_1       0   /* dt <  threshold_12               */
+#define SBA_SYM_12      1   /* dt == threshold_12               */
+#define SBA_SYM_2       2   /* threshold_12 < dt <= threshold_23 */
+#define SBA_SYM_3       3   /* dt >  threshold_23               */
+
+/* decoder state, see DecodeEdges() */
+enum SbaState {
+    sbs_acquire,    /* no lock, thresholds recomputed and preamble searched on every pass */
+    sbs_track,      /* locked, only the edge after the previous subframe is checked */
+    sbs_relock      /* just lost lock, scanning ahead with the last good thresholds */
+};
+
+/* subframes decoded in sbs_track between threshold refreshes */
+#define SBA_TRACK_REFRESH   32
+
+/* edges sbs_relock looks at before giving up, a subframe is never more than 60 */
+#define SBA_RELOCK_EDGES    SPDIF_ANALYZER_SAMPLE_EDGES
+
+/* the start of the symbol ring is mirrored past its end so 64 symbols can be read from anywhere */
+#define SBA_SYM_PAD     64
+
+/*
+ *  BMC decode of 8 edges at a time, indexed by a bitmask of which edges are
+ *  short (bit 0 = first edge).  A short edge is a 1 and skips its partner, a
+ *  long edge is a 0.  Each entry is
+ *
+ *      bits 0-7    decoded bits, first bit in bit 0
+ *      bits 8-11   number of bits decoded (4..8)
+ *      bits 12-15  number of edges consumed (8 or 9)
+ */
+static const uint16_t s_bmc_table[256] =
+{
+    0x8800, 0x8701, 0x8702, 0x8701, 0x8704, 0x8603, 0x8702, 0x8603,
+    0x8708, 0x8605, 0x8606, 0x8605, 0x8704, 0x8603, 0x8606, 0x8603,
+    0x8710, 0x8609, 0x860a, 0x8609, 0x860c, 0x8507, 0x860a, 0x8507,
+    0x8708, 0x8605, 0x8606, 0x8605, 0x860c, 0x8507, 0x8606, 0x8507,
+    0x8720, 0x8611, 0x8612, 0x8611, 0x8614, 0x850b, 0x8612, 0x850b,
+    0x8618, 0x850d, 0x850e, 0x850d, 0x8614, 0x850b, 0x850e, 0x850b,
+    0x8710, 0x8609, 0x860a, 0x8609, 0x860c, 0x8507, 0x860a, 0x8507,
+    0x8618, 0x850d, 0x850e, 0x850d, 0x860c, 0x8507, 0x850e, 0x8507,
+    0x8740, 0x8621, 0x8622, 0x8621, 0x8624, 0x8513, 0x8622, 0x8513,
+    0x8628, 0x8515, 0x8516, 0x8515, 0x8624, 0x8513, 0x8516, 0x8513,
+    0x8630, 0x8519, 0x851a, 0x8519, 0x851c, 0x840f, 0x851a, 0x840f,
+    0x8628, 0x8515, 0x8516, 0x8515, 0x851c, 0x840f, 0x8516, 0x840f,
+    0x8720, 0x8611, 0x8612, 0x8611, 0x8614, 0x850b, 0x8612, 0x850b,
+    0x8618, 0x850d, 0x850e, 0x850d, 0x8614, 0x850b, 0x850e, 0x850b,
+    0x8630, 0x8519, 0x851a, 0x8519, 0x851c, 0x840f, 0x851a, 0x840f,
+    0x8618, 0x850d, 0x850e, 0x850d, 0x851c, 0x840f, 0x850e, 0x840f,
+    0x9880, 0x9741, 0x9742, 0x9741, 0x9744, 0x9623, 0x9742, 0x9623,
+    0x9748, 0x9625, 0x9626, 0x9625, 0x9744, 0x9623, 0x9626, 0x9623,
+    0x9750, 0x9629, 0x962a, 0x9629, 0x962c, 0x9517, 0x962a, 0x9517,
+    0x9748, 0x9625, 0x9626, 0x9625, 0x962c, 0x9517, 0x9626, 0x9517,
+    0x9760, 0x9631, 0x9632, 0x9631, 0x9634, 0x951b, 0x9632, 0x951b,
+    0x9638, 0x951d, 0x951e, 0x951d, 0x9634, 0x951b, 0x951e, 0x951b,
+    0x9750, 0x9629, 0x962a, 0x9629, 0x962c, 0x9517, 0x962a, 0x9517,
+    0x9638, 0x951d, 0x951e, 0x951d, 0x962c, 0x9517, 0x951e, 0x9517,
+    0x8740, 0x8621, 0x8622, 0x8621, 0x8624, 0x8513, 0x8622, 0x8513,
+    0x8628, 0x8515, 0x8516, 0x8515, 0x8624, 0x8513, 0x8516, 0x8513,
+    0x8630, 0x8519, 0x851a, 0x8519, 0x851c, 0x840f, 0x851a, 0x840f,
+    0x8628, 0x8515, 0x8516, 0x8515, 0x851c, 0x840f, 0x8516, 0x840f,
+    0x9760, 0x9631, 0x9632, 0x9631, 0x9634, 0x951b, 0x9632, 0x951b,
+    0x9638, 0x951d, 0x951e, 0x951d, 0x9634, 0x951b, 0x951e, 0x951b,
+    0x8630, 0x8519, 0x851a, 0x8519, 0x851c, 0x840f, 0x851a, 0x840f,
+    0x9638, 0x951d, 0x951e, 0x951d, 0x851c, 0x840f, 0x951e, 0x840f,
+};
+
+/* index of the lowest set bit, x is not 0 */
+static inline unsigned int sba_Ctz64( uint64_t x )
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long   i;
+
+    _BitScanForward64( &i, x );
+    return( (unsigned int) i );
+#elif defined(_MSC_VER)
+    unsigned long   i;
+
+    if ( _BitScanForward( &i, (unsigned long) x ) )
+        return( (unsigned int) i );
+    _BitScanForward( &i, (unsigned long)( x >> 32 ) );
+    return( (unsigned int) i + 32 );
+#else
+    return( (unsigned int) __builtin_ctzll( x ) );
+#endif
+}
+
+#if defined(SBA_EDGES_POPCNT)
+/* index of the highest set bit counted down from 63, x is not 0 */
+static inline unsigned int sba_Clz64( uint64_t x )
+{
+#if defined(_MSC_VER)
+    unsigned long   i;
+
+    _BitScanReverse64( &i, x );
+    return( 63 - (unsigned int) i );
+#else
+    return( (unsigned int) __builtin_clzll( x ) );
+#endif
+}
+
+static inline unsigned int sba_Popcount64( uint64_t x )
+{
+#if defined(_MSC_VER)
+    return( (unsigned int) __popcnt64( x ) );
+#else
+    return( (unsigned int) __builtin_popcountll( x ) );
+#endif
+}
+#endif
+
+/* classify n 16-bit widths into SBA_SYM_x */
+static inline void sba_ClassifyRun(
+    const uint16_t                  *dt,
+    unsigned char                   *sym,
+    unsigned int                     n,
+    uint16_t                         threshold_12,
+    uint16_t                         threshold_23 )
+{
+    unsigned int    i = 0;
+
+    /*
+     *  sym = (dt >= t12) + (dt > t12) + (dt > t23), computed 16 or 8 lanes at a time.
+     *  There is no unsigned compare, a saturating subtract that comes out 0 is one.
+     *  The compares give -1 for true:  2 - (dt >= t12) + (dt <= t12) + (dt <= t23)
+     */
+#if defined(SBA_CLASSIFY_AVX2)
+    const __m256i   t12 = _mm256_set1_epi16( (short)threshold_12 );
+    const __m256i   t23 = _mm256_set1_epi16( (short)threshold_23 );
+    const __m256i   two = _mm256_set1_epi16( 2 );
+    const __m256i   zero = _mm256_setzero_si256();
+
+    for ( ; (i + 16) <= n; i += 16 )
+    {
+        __m256i d  = _mm256_loadu_si256( (const __m256i *)&dt[i] );
+        __m256i ge12 = _mm256_cmpeq_epi16( _mm256_subs_epu16( t12, d ), zero );
+        __m256i le12 = _mm256_cmpeq_epi16( _mm256_subs_epu16( d, t12 ), zero );
+        __m256i le23 = _mm256_cmpeq_epi16( _mm256_subs_epu16( d, t23 ), zero );
+        __m256i s  = _mm256_add_epi16( _mm256_sub_epi16( two, ge12 ), _mm256_add_epi16( le12, le23 ) );
+
+        s = _mm256_permute4x64_epi64( _mm256_packus_epi16( s, zero ), 0xd8 );
+        _mm_storeu_si128( (__m128i *)&sym[i], _mm256_castsi256_si128( s ) );
+    }
+#elif defined(SBA_CLASSIFY_SSE2)
+    const __m128i   t12 = _mm_set1_epi16( (short)threshold_12 );
+    const __m128i   t23 = _mm_set1_epi16( (short)threshold_23 );
+    const __m128i   two = _mm_set1_epi16( 2 );
+    const __m128i   zero = _mm_setzero_si128();
+
+    for ( ; (i + 8) <= n; i += 8 )
+    {
+        __m128i d  = _mm_loadu_si128( (const __m128i *)&dt[i] );
+        __m128i ge12 = _mm_cmpeq_epi16( _mm_subs_epu16( t12, d ), zero );
+        __m128i le12 = _mm_cmpeq_epi16( _mm_subs_epu16( d, t12 ), zero );
+        __m128i le23 = _mm_cmpeq_epi16( _mm_subs_epu16( d, t23 ), zero );
+        __m128i s  = _mm_add_epi16( _mm_sub_epi16( two, ge12 ), _mm_add_epi16( le12, le23 ) );
+
+        _mm_storel_epi64( (__m128i *)&sym[i], _mm_packus_epi16( s, zero ) );
+    }
+#endif
+
+    for ( ; i < n; i++ )
+    {
+        sym[i] = (unsigned char)( (dt[i] >= threshold_12) + (dt[i] > threshold_12) + (dt[i] > threshold_23) );
+    }
+}
+
+/* classify n 8-bit widths into SBA_SYM_x, same arithmetic with twice the lanes and no packing */
+static inline void sba_ClassifyRun(
+    const uint8_t                   *dt,
+    unsigned char                   *sym,
+    unsigned int                     n,
+    uint8_t                          threshold_12,
+    uint8_t                          threshold_23 )
+{
+    unsigned int    i = 0;
+
+#if defined(SBA_CLASSIFY_AVX2)
+    const __m256i   t12 = _mm256_set1_epi8( (char)threshold_12 );
+    const __m256i   t23 = _mm256_set1_epi8( (char)threshold_23 );
+    const __m256i   two = _mm256_set1_epi8( 2 );
+    const __m256i   zero = _mm256_setzero_si256();
+
+    for ( ; (i + 32) <= n; i += 32 )
+    {
+        __m256i d  = _mm256_loadu_si256( (const __m256i *)&dt[i] );
+        __m256i ge12 = _mm256_cmpeq_epi8( _mm256_subs_epu8( t12, d ), zero );
+        __m256i le12 = _mm256_cmpeq_epi8( _mm256_subs_epu8( d, t12 ), zero );
+        __m256i le23 = _mm256_cmpeq_epi8( _mm256_subs_epu8( d, t23 ), zero );
+        __m256i s  = _mm256_add_epi8( _mm256_sub_epi8( two, ge12 ), _mm256_add_epi8( le12, le23 ) );
+
+        _mm256_storeu_si256( (__m256i *)&sym[i], s );
+    }
+#elif defined(SBA_CLASSIFY_SSE2)
+    const __m128i   t12 = _mm_set1_epi8( (char)threshold_12 );
+    const __m128i   t23 = _mm_set1_epi8( (char)threshold_23 );
+    const __m128i   two = _mm_set1_epi8( 2 );
+    const __m128i   zero = _mm_setzero_si128();
+
+    for ( ; (i + 16) <= n; i += 16 )
+    {
+        __m128i d  = _mm_loadu_si128( (const __m128i *)&dt[i] );
+        __m128i ge12 = _mm_cmpeq_epi8( _mm_subs_epu8( t12, d ), zero );
+        __m128i le12 = _mm_cmpeq_epi8( _mm_subs_epu8( d, t12 ), zero );
+        __m128i le23 = _mm_cmpeq_epi8( _mm_subs_epu8( d, t23 ), zero );
+        __m128i s  = _mm_add_epi8( _mm_sub_epi8( two, ge12 ), _mm_add_epi8( le12, le23 ) );
+
+        _mm_storeu_si128( (__m128i *)&sym[i], s );
+    }
+#endif
+
+    for ( ; i < n; i++ )
+    {
+        sym[i] = (unsigned char)( (dt[i] >= threshold_12) + (dt[i] > threshold_12) + (dt[i] > threshold_23) );
+    }
+}
+
+/*
+ *  Dt           uint8_t or uint16_t, widths at or above the largest value are saturated
+ *  WindowEdges  edges the thresholds are computed over and decoded from per pass,
+ *               a power of two holding at least two subframes
+ *  Sink         receives the decoded subframes, see above
+ */
+template <typename Dt, unsigned int WindowEdges, class Sink>
+struct SpdifDecoder
+{
+    enum {
+        MAX_EDGES   = WindowEdges<<1,
+        EDGE_MASK   = MAX_EDGES-1,
+        DT_MAX      = (Dt)~(Dt)0
+    };
+
+    static_assert( 0 == (WindowEdges & (WindowEdges-1)), "window must be a power of two" );
+    static_assert( WindowEdges >= (SPDIF_ANALYZER_SAMPLE_EDGES<<1), "window must hold two subframes" );
+
+    Sink               *sink;
+
+    /* local analyzer looks at most recent edges, only their widths are kept */
+    Dt                  dt[MAX_EDGES];
+    uint64_t            dt_excess[MAX_EDGES];   /* width past DT_MAX, only where dt[] is DT_MAX */
+    unsigned char       sym[MAX_EDGES+SBA_SYM_PAD];     /* SBA_SYM_x of each edge */
+    Dt                  blk_min[MAX_EDGES>>SBA_BLOCK_SHIFT];    /* min/max of dt per block */
+    Dt                  blk_max[MAX_EDGES>>SBA_BLOCK_SHIFT];
+    uint64_t            w_edgenum;
+    uint64_t            r_edgenum;
+
+    /* edge times are rebuilt from dt, t_time is the sum of the first t_edgenum widths */
+    uint64_t            t_edgenum;
+    uint64_t            t_time;
+
+    uint64_t            n_syncs;
+    uint64_t            sync_start_time;
+    uint64_t            sync_end_time;
+    uint64_t            prev_b_dt;
+    uint64_t            prev_b_nsyncs;
+    uint64_t            n_b_syncs;
+    uint64_t            last_b_sync;
+    uint64_t            last_b_time;
+
+    Dt                  last_threshold_12;
+    Dt                  last_threshold_23;
+
+    /* thresholds sym[] was classified with, valid up to c_edgenum */
+    Dt                  threshold_12;
+    Dt                  threshold_23;
+    uint64_t            c_edgenum;
+
+    enum SbaState       state;
+    unsigned int        since_refresh;
+    struct SpdifDecoderStats    stats;
+
+    /* thresholds at the last preamble that matched, and where lock was lost */
+    Dt                  good_threshold_12;
+    Dt                  good_threshold_23;
+    int                 lost_sync;
+    uint64_t            lost_edgenum;
+    uint64_t            lost_time;
+
+    /* sample for current word */
+    uint32_t            sample;
+
+    unsigned int        channel_status_left_bits;
+    unsigned int        channel_status_right_bits;
+
+    struct SpdifChannelStatus   cur_cs;
+    struct SpdifChannelStatus   prev_cs;
+
+    /* optional, blocks and checkpoints are recorded in it as they are decoded */
+    struct SpdifBlockIndex     *index;
+    int                         checkpoint_due;
+
+    /* ---------------------------------------------------------------------------------------- */
+
+    void ClassifyEdges(
+        uint64_t                         edgenum )
+    {
+        unsigned int    r,n,run;
+
+        /* everything from edgenum up to the write pointer, in at most two pieces of the ring */
+        r = (unsigned int) edgenum & EDGE_MASK;
+        n = (unsigned int) (w_edgenum - edgenum);
+
+        run = MAX_EDGES - r;
+        if ( run > n )
+            run = n;
+
+        sba_ClassifyRun( &dt[r], &sym[r], run, threshold_12, threshold_23 );
+        sba_ClassifyRun( &dt[0], &sym[0], n - run, threshold_12, threshold_23 );
+
+        memcpy( &sym[MAX_EDGES], &sym[0], SBA_SYM_PAD );
+
+        c_edgenum = w_edgenum;
+    }
+
+    uint64_t ShortEdges(
+        uint64_t                         edgenum ) const
+    {
+        const unsigned char *s = &sym[ edgenum & EDGE_MASK ];
+        uint64_t        shorts = 0;
+        unsigned int    i;
+
+        /* bit i is set when edge (edgenum+i) is a short edge */
+    #if defined(SBA_CLASSIFY_AVX2)
+        const __m256i   zero = _mm256_setzero_si256();
+
+        for ( i = 0; i < 64; i += 32 )
+        {
+            __m256i v = _mm256_loadu_si256( (const __m256i *)&s[i] );
+            shorts |= (uint64_t)(uint32_t)_mm256_movemask_epi8( _mm256_cmpeq_epi8( v, zero ) ) << i;
+        }
+    #elif defined(SBA_CLASSIFY_SSE2)
+        const __m128i   zero = _mm_setzero_si128();
+
+        for ( i = 0; i < 64; i += 16 )
+        {
+            __m128i v = _mm_loadu_si128( (const __m128i *)&s[i] );
+            shorts |= (uint64_t)(uint16_t)_mm_movemask_epi8( _mm_cmpeq_epi8( v, zero ) ) << i;
+        }
+    #else
+        for ( i = 0; i < 64; i++ )
+        {
+            shorts |= (uint64_t)(SBA_SYM_1 == s[i]) << i;
+        }
+    #endif
+
+        return(shorts);
+    }
+
+    enum SpdifFrameType PreambleAt(
+        uint64_t                         edgenum ) const
+    {
+        const unsigned char *s = &sym[ edgenum & EDGE_MASK ];
+
+        /* http://www.epanorama.net/documents/audio/spdif.html
+         *  There are 3 different sync-patterns, but they can appear in
+         *  different forms, depending on the last cell of the previous 32-bit word (parity):
+         *
+         *    Preamble    cell-order         cell-order
+         *        (last cell "0")    (last cell "1")
+         *    ----------------------------------------------
+         *    "B"         11101000           00010111
+         *    "M"         11100010           00011101
+         *    "W"         11100100           00011011
+        */
+
+        /* start of 111 or 000 code? (sym[] is padded, no need to mask) */
+        if ( SBA_SYM_3 == s[0] )
+        {
+            if ( SBA_SYM_3 == s[1] )
+            {
+                /* 111.000 */
+                /* check for  10 */
+                if ( (SBA_SYM_1 == s[2]) &&
+                     (SBA_SYM_1 == s[3]) )
+                {
+                    return(sft_M); /* left  */
+                }
+            }
+            else if ( SBA_SYM_2 == s[1] )
+            {
+                /* 111.00 */
+                /* check for  100 */
+                if ( (SBA_SYM_1 == s[2]) &&
+                     ( (SBA_SYM_12 == s[3]) || (SBA_SYM_2 == s[3]) ) )
+                {
+                    return(sft_W); /* right */
+                }
+            }
+            else
+            {
+                /* 111.0 */
+                /* check for  1000 */
+                if ( (SBA_SYM_1 == s[2]) &&
+                     (SBA_SYM_3 == s[3]) )
+                {
+                    return(sft_B); /* left, B */
+                }
+            }
+        }
+
+        return(sft_invalid);
+    }
+
+    enum SpdifFrameType FindSync()
+    {
+        enum SpdifFrameType found_sync = sft_invalid;
+        unsigned int    nbits;
+
+        for ( nbits = 0; nbits < SPDIF_ANALYZER_SAMPLE_EDGES; nbits++ )
+        {
+            if ( sft_invalid != (found_sync = PreambleAt( r_edgenum + nbits )) )
+            {
+                break;
+            }
+
+        #ifdef SELF_TEST
+            {
+                unsigned int    i = (unsigned int) (r_edgenum + nbits);
+
+                if ( SBA_SYM_3 == sym[i & EDGE_MASK] )
+                {
+                    printf("bad %c sync @%d {%d,%d} [%d %d %d %d]\n",
+                        "BBWM"[ sym[(i+1) & EDGE_MASK] ],
+                        (unsigned int) r_edgenum,
+                        threshold_12,
+                        threshold_23,
+                        dt[(i+0) & EDGE_MASK],
+                        dt[(i+1) & EDGE_MASK],
+                        dt[(i+2) & EDGE_MASK],
+                        dt[(i+3) & EDGE_MASK] );
+                }
+            }
+        #endif
+        }
+
+        /* move read pointer to either the beginning of sync or the end of the edges so far */
+        r_edgenum += nbits;
+
+        return(found_sync);
+    }
+
+    void ReadSample(
+        enum SpdifFrameType              sample_type )
+    {
+        unsigned int    bitpos,pos;
+        unsigned char   bitmask,submask,valmask;
+        uint64_t        shorts;
+        uint32_t        word = 0;
+        uint32_t        ones;
+
+        /* we've already read the first four edges of the preamble
+         *
+         * The Coding Format
+         *
+         * The digital signal is coded using the 'biphase-mark-code' (BMC),
+         * which is a kind of phase-modulation. In this system, two zero-crossings
+         * of the signal mean a logical 1 and one zero-crossing means a logical 0.
+         *
+         *                 _   _   _   _   _   _   _   _   _   _   _   _
+         *                | | | | | | | | | | | | | | | | | | | | | | | |
+         * clock   0 ___ _| |_| |_| |_| |_| |_| |_| |_| |_| |_| |_| |_| |_
+         *
+         *                 ___         _______     ___         ___
+         *                |   |       |       |   |   |       |   |
+         * data    0 ___ _|   |_______|       |___|   |_______|   |___
+         * signal           1   0   0   1   1   0   1   0   0   1   0
+         *
+         *                 _   ___     _   _   ___   _     ___   _
+         * Biphase        | | |   |   | | | | |   | | |   |   | | |
+         * Mark    0 ___  | | |   |   | | | | |   | | |   |   | | |
+         * signal         | | |   |   | | | | |   | | |   |   | | |
+         *               _| |_|   |___| |_| |_|   |_| |___|   |_| |___
+         *
+         * cells           1 0 1 1 0 0 1 0 1 0 1 1 0 1 0 0 1 1 0 1 0 0
+         *
+        */
+        shorts = ShortEdges( r_edgenum + 4 );
+
+        /*
+         * Decode 8 edges per table lookup.  The last lookup may run past bit 31,
+         * those bits simply fall off the top of the word.
+         */
+        for ( bitpos = 4, pos = 0; bitpos < 32; )
+        {
+            uint16_t    ent = s_bmc_table[ (shorts >> pos) & 0xff ];
+
+            word |= (uint32_t)(ent & 0xff) << bitpos;
+            bitpos += (ent >> 8) & 0xf;
+            pos += ent >> 12;
+        }
+
+        /* four preamble edges, then one edge per 0 and two per 1 */
+        ones = word >> 4;
+        ones = ones - ((ones >> 1) & 0x55555555);
+        ones = (ones & 0x33333333) + ((ones >> 2) & 0x33333333);
+        ones = (((ones + (ones >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+
+        r_edgenum += 4 + 28 + ones;
+        sample = word;
+
+        /*
+         * Word and Block Formats
+         *
+         * Every sample is transmitted as a 32-bit word (subframe). These bits are used as follows:
+         *
+         *    bits           meaning
+         *    ----------------------------------------------------------
+         *    0-3            Preamble (see above; special structure)
+         *
+         *    4-7            Auxillary-audio-databits
+         *
+         *    8-27           Sample
+         *   (A 24-bit sample can be used (using bits 4-27).
+         *    A CD-player uses only 16 bits, so only bits
+         *    13 (LSB) to 27 (MSB) are used. Bits 4-12 are
+         *    set to 0).
+         *
+         *    28             Validity
+         *   (When this bit is set, the sample should not
+         *    be used by the receiver. A CD-player uses
+         *    the 'error-flag' to set this bit).
+         *
+         *    29             Subcode-data
+         *
+         *    30             Channel-status-information
+         *
+         *    31             Parity (bit 0-3 are not included)
+         */
+
+        /* get bit 30 */
+        bitmask = (word >> 30) & 0x1;  /* 30 = channel status */
+        submask = (word >> 29) & 0x1;  /* 31 = parity, 29 = subcode, 28 = validity */
+        valmask = (word >> 28) & 0x1;  /* 31 = parity, 29 = subcode, 28 = validity */
+
+        if ( sft_W == sample_type ) /* right channel */
+        {
+            cur_cs.channel_status_right[ channel_status_right_bits>>3 ] |=
+                bitmask << (channel_status_right_bits & 0x7);
+
+            cur_cs.subframe_right[ channel_status_right_bits>>3 ] |=
+                submask << (channel_status_right_bits & 0x7);
+
+            cur_cs.validity_right[ channel_status_right_bits>>3 ] |=
+                valmask << (channel_status_right_bits & 0x7);
+
+            if ( ++channel_status_right_bits >= CHANNEL_STATUS_NBITS )
+            {
+                //printf("ERR: no B-sync???\n");
+                channel_status_right_bits = 0;
+            }
+        }
+        else    /* 2 or 3 */    /* left channel */
+        {
+            cur_cs.channel_status_left[ channel_status_left_bits>>3 ] |=
+                bitmask << (channel_status_left_bits & 0x7);
+
+            cur_cs.subframe_left[ channel_status_left_bits>>3 ] |=
+                submask << (channel_status_left_bits & 0x7);
+
+            cur_cs.validity_left[ channel_status_left_bits>>3 ] |=
+                valmask << (channel_status_left_bits & 0x7);
+
+            if ( ++channel_status_left_bits >= CHANNEL_STATUS_NBITS )
+            {
+                //printf("ERR: no B-sync???\n");
+                channel_status_left_bits = 0;
+            }
+        }
+    }
+
+    /*
+     *  Time of an edge, summed up from the widths.  The decoder only asks for
+     *  edges near the read pointer, which moves forward, so each width is
+     *  normally added once.  Stepping back works as long as dt[] still holds it.
+     */
+    uint64_t EdgeTime(
+        uint64_t                         edgenum )
+    {
+        while ( t_edgenum <= edgenum )
+        {
+            unsigned int    e = (unsigned int)(t_edgenum++ & EDGE_MASK);
+
+            t_time += dt[e];
+            if ( DT_MAX == dt[e] )
+                t_time += dt_excess[e];
+        }
+
+        while ( t_edgenum > edgenum + 1 )
+        {
+            unsigned int    e = (unsigned int)(--t_edgenum & EDGE_MASK);
+
+            t_time -= dt[e];
+            if ( DT_MAX == dt[e] )
+                t_time -= dt_excess[e];
+        }
+
+        return t_time;
+    }
+
+    void TrackEdge(
+        uint64_t                         edgenum,
+        Dt                               d )
+    {
+        unsigned int    b = (unsigned int)(edgenum & EDGE_MASK) >> SBA_BLOCK_SHIFT;
+        int             first = 0 == (edgenum & SBA_BLOCK_MASK);
+        Dt              mn,mx;
+
+        /*
+         *  Fold the new edge into the min/max of its block, starting over on the first
+         *  edge of a block.  Written to come out as conditional moves, a data dependent
+         *  branch per edge costs more than the rescan this replaces.
+         */
+        mn = first ? (Dt)DT_MAX : blk_min[b];
+        mx = first ? (Dt)0 : blk_max[b];
+
+        blk_min[b] = (d < mn) ? d : mn;
+        blk_max[b] = (d > mx) ? d : mx;
+    }
+
+    /* store the width of edge edgenum, saturating it to Dt */
+    void PutEdge(
+        uint64_t                         edgenum,
+        uint64_t                         width )
+    {
+        unsigned int    e = (unsigned int)(edgenum & EDGE_MASK);
+        Dt              d = (width < (uint64_t)DT_MAX) ? (Dt)width : (Dt)DT_MAX;
+
+        if ( DT_MAX == d )
+            dt_excess[e] = width - DT_MAX;
+
+        dt[e] = d;
+        TrackEdge( edgenum, d );
+    }
+
+    void WindowExtremes(
+        unsigned int                    *pmin_dt,
+        unsigned int                    *pmax_dt ) const
+    {
+        uint64_t        r = r_edgenum;
+        uint64_t        w = w_edgenum;
+        Dt              min_dt = (Dt)DT_MAX;
+        Dt              max_dt = 0;
+
+        /* edges up to the first block boundary one at a time */
+        for ( ; (r < w) && (r & SBA_BLOCK_MASK); r++ )
+        {
+            Dt          d = dt[ r & EDGE_MASK ];
+
+            min_dt = (d < min_dt) ? d : min_dt;
+            max_dt = (d > max_dt) ? d : max_dt;
+        }
+
+        /* then whole blocks, the last one only holds the edges written so far */
+        for ( ; r < w; r += SBA_BLOCK_EDGES )
+        {
+            unsigned int    b = (unsigned int)(r & EDGE_MASK) >> SBA_BLOCK_SHIFT;
+
+            min_dt = (blk_min[b] < min_dt) ? blk_min[b] : min_dt;
+            max_dt = (blk_max[b] > max_dt) ? blk_max[b] : max_dt;
+        }
+
+        *pmin_dt = min_dt;
+        *pmax_dt = max_dt;
+    }
+
+    unsigned int AnalyzeRecentEdges(
+        Dt                              *pthreshold_12,
+        Dt                              *pthreshold_23 ) const
+    {
+        unsigned int    min_dt = 0;
+        unsigned int    max_dt = 0;
+        unsigned int    mid_dt = 0;
+        unsigned int    t12,t23;
+
+        /* min/max over r_edgenum..w_edgenum, mostly from the per-block summaries */
+        WindowExtremes( &min_dt, &max_dt );
+
+        /*
+         *  The clocks pulses are 1, 2, and 3 spdif clocks wide
+         *
+         *  We've just captured the smallest clock pulse and the largest
+         *  which should correspond to the shortest duration 1-clock
+         *  pulse and the longest duration 3-clock pulse.
+         *
+         *  This means the 2 clock width should center between min/max
+         *
+         *  |-min                              max-|
+         *  111                                  333
+         *                    222 - calculated
+         *                     |
+         *          t12                 t23
+         *           |-------------------|     -> solution 1, split the difference
+         *
+         *                  t12 t23
+         *                    |-|              -> solution 2, surround the center by 1 clk
+         */
+
+        if ( (int)(max_dt - min_dt) > 9 )
+        {
+          /* same as above but higher precision */
+          mid_dt = (min_dt + max_dt);
+          t12 = ((min_dt << 1) + mid_dt) >> 2;
+          t23 = ((max_dt << 1) + mid_dt) >> 2;
+        }
+        else
+        {
+          mid_dt = (min_dt + max_dt);
+          t12 = (mid_dt - 2) >> 1;
+          t23 = (mid_dt + 2) >> 1;
+        }
+
+        /* a window of saturated widths must not wrap the thresholds around */
+        *pthreshold_12 = (Dt)((t12 < (unsigned int)DT_MAX) ? t12 : (unsigned int)DT_MAX);
+        *pthreshold_23 = (Dt)((t23 < (unsigned int)DT_MAX) ? t23 : (unsigned int)DT_MAX);
+
+        /* is there any room for a two-tick width? */
+        if ( (int)(*pthreshold_23 - *pthreshold_12) <= 1 )
+        {
+            /* no sync */
+            min_dt = 0;
+        }
+
+        return(min_dt);
+    }
+
+    void DecodeSubframe(
+        enum SpdifFrameType              synctype )
+    {
+        n_syncs++;
+
+        //printf("synctype :%x @ %ld [%d,%d] %04x, %04x\n",
+        //    synctype,
+        //    EdgeTime( r_edgenum ),
+        //    threshold_12, threshold_23,
+        //    r_edgenum, w_edgenum );
+
+        //if  ( 187565 == EdgeTime( r_edgenum ) )
+        //    printf("debug...\n");
+
+
+        if ( sft_B == synctype )
+        {
+            n_b_syncs++;
+
+          #ifdef SELF_TEST
+            if ( n_b_syncs <= 1 ) {
+                printf("B:{%d, [%d,%d,%d,%d] [%d..%d] [%d,%d,%d,%d]}\n", (unsigned int) r_edgenum,
+                    dt[(r_edgenum+0) & EDGE_MASK],
+                    dt[(r_edgenum+1) & EDGE_MASK],
+                    dt[(r_edgenum+2) & EDGE_MASK],
+                    dt[(r_edgenum+3) & EDGE_MASK],
+                    threshold_12,
+                    threshold_23,
+                    dt[(r_edgenum+4) & EDGE_MASK],
+                    dt[(r_edgenum+5) & EDGE_MASK],
+                    dt[(r_edgenum+6) & EDGE_MASK],
+                    dt[(r_edgenum+7) & EDGE_MASK] );
+            }
+          #endif
+
+            if ( n_b_syncs > 1 ) {
+                /* do the callbacks */
+                sink->status_callback(
+                    last_b_time,       /* last_b_time is when this started */
+                    EdgeTime( r_edgenum ),
+                    &cur_cs );
+
+                prev_b_nsyncs = n_syncs - last_b_sync;
+                prev_b_dt = EdgeTime( r_edgenum ) - last_b_time;
+            }
+
+            last_b_sync = n_syncs;
+            last_b_time = EdgeTime( r_edgenum );
+
+            /*
+             *  Refresh the thresholds on the next subframe.  Keeping the refreshes in
+             *  step with the blocks means a decoder that locked anywhere in an earlier
+             *  block ends up in the same state as one that locked at the start.
+             */
+            since_refresh = SBA_TRACK_REFRESH - 1;
+
+            if ( NULL != index )
+                IndexBlock();
+
+            /* B frame, start re-capturing channnel status stuff */
+            channel_status_left_bits = 0;
+            channel_status_right_bits = 0;
+
+            memcpy( &prev_cs, &cur_cs, sizeof(cur_cs));
+
+            memset( &cur_cs, 0, sizeof(cur_cs));
+        }
+
+        if ( sbs_track == state )
+            stats.track_subframes++;
+        else if ( sbs_relock == state )
+            stats.relock_subframes++;
+        else
+            stats.acquire_subframes++;
+
+        /* read the rest of the bits */
+        sync_start_time = EdgeTime( r_edgenum );
+
+        ReadSample( synctype );
+
+        sync_end_time = EdgeTime( r_edgenum );
+
+        /*
+         *  A subframe is followed by the next preamble.  One that is not ran into
+         *  whatever is about to break lock and its bits can not be trusted, say so
+         *  before it goes out.
+         */
+        if ( ((int64_t)(c_edgenum - r_edgenum) >= 4) && (sft_invalid == PreambleAt( r_edgenum )) )
+        {
+            stats.suspect_subframes++;
+            sink->suspect_callback( sync_start_time, sync_end_time );
+        }
+
+        /* do the callback */
+        sink->sample_callback(
+            sync_start_time,
+            sync_end_time,
+            synctype,
+            sample );
+    }
+
+    /* note the block this B preamble starts, a checkpoint is taken after the pass if one is due */
+    void IndexBlock()
+    {
+        uint64_t        block = n_b_syncs - 1;
+        uint64_t        interval = index->interval ? index->interval : 1;
+
+        if ( (block == index->nblocks) && (index->nblocks < index->block_capacity) )
+            index->block_time[ index->nblocks++ ] = last_b_time;
+
+        if ( (block == index->ncheckpoints * interval) && (index->ncheckpoints < index->checkpoint_capacity) )
+            checkpoint_due = 1;
+    }
+
+    void SetThresholds(
+        Dt                               t12,
+        Dt                               t23 )
+    {
+        int                             dt12,dt23;
+
+        dt12 = (int) t12 - (int) last_threshold_12;
+        if ( dt12 < 0 )
+            dt12 = -dt12;
+
+        dt23 = (int) t23 - (int) last_threshold_23;
+        if ( dt23 < 0 )
+            dt23 = -dt23;
+
+        if ( (dt12 > 1) || (dt23 > 1) )
+        {
+            #ifdef SELF_TEST
+            printf("thresholds [%d..%d] -> [%d..%d]\n",
+                last_threshold_12,
+                last_threshold_23,
+                t12,
+                t23 );
+            #endif
+            last_threshold_12 = t12;
+            last_threshold_23 = t23;
+        }
+
+        threshold_12 = t12;
+        threshold_23 = t23;
+
+        ClassifyEdges( r_edgenum );
+    }
+
+    void Lock()
+    {
+        uint64_t    t = EdgeTime( r_edgenum );
+
+        /* a preamble at r_edgenum, from now on only look where the next one has to be */
+        since_refresh = 0;
+        good_threshold_12 = threshold_12;
+        good_threshold_23 = threshold_23;
+        stats.locks++;
+
+        if ( lost_sync )
+        {
+            lost_sync = 0;
+
+            stats.lost_time += t - lost_time;
+            if ( stats.lost_time_max < (t - lost_time) )
+                stats.lost_time_max = t - lost_time;
+
+            sink->relock_callback(
+                lost_time,
+                t,
+                (uint32_t)(r_edgenum - lost_edgenum) );
+        }
+    }
+
+    void Unlock()
+    {
+        state = sbs_relock;
+        stats.unlocks++;
+
+        lost_sync = 1;
+        lost_edgenum = r_edgenum;
+        lost_time = EdgeTime( r_edgenum );
+
+        /* a refresh on this pass may have been thrown off by the very edges that broke lock */
+        threshold_12 = good_threshold_12;
+        threshold_23 = good_threshold_23;
+
+        ClassifyEdges( r_edgenum );
+    }
+
+    void AcquirePass()
+    {
+        enum SpdifFrameType         synctype;
+        Dt                          t12 = 0;
+        Dt                          t23 = 0;
+
+        if ( AnalyzeRecentEdges( &t12, &t23 ) )
+        {
+            SetThresholds( t12, t23 );
+
+            if ( 0 != (synctype = FindSync()) )
+            {
+                Lock();
+                DecodeSubframe( synctype );
+                state = sbs_track;
+            }
+            else
+            {
+              #ifdef SELF_TEST
+                static unsigned int skips = 0;
+                if ( ++skips < 10 )
+                {
+                /* skip forward */
+                printf("no sync [%2d..%2d], skipping @%lu...\n", t12, t23, (unsigned long) EdgeTime( r_edgenum ));
+                }
+              #endif
+                r_edgenum += SPDIF_ANALYZER_SAMPLE_EDGES>>1;
+            }
+        }
+        else
+        {
+            /* skip forward */
+          #ifdef SELF_TEST
+            printf("bad signal [%d,%d], skipping...\n", t12, t23 );
+          #endif
+            r_edgenum += SPDIF_ANALYZER_SAMPLE_EDGES>>1;
+        }
+    }
+
+    void TrackPass()
+    {
+        enum SpdifFrameType         synctype;
+        Dt                          t12 = 0;
+        Dt                          t23 = 0;
+
+        if ( ! AnalyzeRecentEdges( &t12, &t23 ) )
+        {
+            Unlock();
+            return;
+        }
+
+        /*
+         *  The window min/max is cheap to look at, reclassifying it is not.  Keep the
+         *  thresholds sym[] was classified with until they are due for a refresh or
+         *  the window says they are off by more than the usual tick of jitter.
+         */
+        if ( (++since_refresh >= SBA_TRACK_REFRESH) ||
+             ((unsigned int)((int) t12 - (int) threshold_12 + 1) > 2) ||
+             ((unsigned int)((int) t23 - (int) threshold_23 + 1) > 2) )
+        {
+            since_refresh = 0;
+            stats.refreshes++;
+
+            SetThresholds( t12, t23 );
+        }
+        else
+        {
+            /* only the edges that arrived since need classifying */
+            ClassifyEdges( c_edgenum );
+        }
+
+        /* the previous subframe ended right where this preamble should start */
+        if ( sft_invalid == (synctype = PreambleAt( r_edgenum )) )
+        {
+            Unlock();
+            return;
+        }
+
+        good_threshold_12 = threshold_12;
+        good_threshold_23 = threshold_23;
+
+        DecodeSubframe( synctype );
+    }
+
+    void RelockPass()
+    {
+        enum SpdifFrameType         synctype = sft_invalid;
+        unsigned int                nbits;
+
+        ClassifyEdges( c_edgenum );
+
+        /*
+         *  Whatever upset the last subframe, the thresholds from before it are still
+         *  the best guess, and the next preamble is at most a subframe away.  Walk
+         *  every edge up to that bound instead of waiting for a fresh window.
+         */
+        for ( nbits = 0; (r_edgenum + nbits - lost_edgenum) < SBA_RELOCK_EDGES; nbits++ )
+        {
+            if ( sft_invalid != (synctype = PreambleAt( r_edgenum + nbits )) )
+            {
+                break;
+            }
+        }
+
+        r_edgenum += nbits;
+
+        if ( sft_invalid == synctype )
+        {
+            /* not where it should be, the signal itself must have changed */
+            state = sbs_acquire;
+            stats.relock_fallbacks++;
+            return;
+        }
+
+        stats.relocks++;
+
+        Lock();
+        DecodeSubframe( synctype );
+        state = sbs_track;
+    }
+
+    void DecodeEdges()
+    {
+        /* a full window of data present */
+        while ( (int)(w_edgenum - r_edgenum) >= (int)WindowEdges )
+        {
+            uint64_t        r = r_edgenum;
+            uint64_t        t = EdgeTime( r );
+
+            if ( sbs_track == state )
+            {
+                TrackPass();
+
+                stats.track_edges += r_edgenum - r;
+                stats.track_time += EdgeTime( r_edgenum ) - t;
+            }
+            else if ( sbs_relock == state )
+            {
+                RelockPass();
+
+                stats.relock_edges += r_edgenum - r;
+                stats.relock_time += EdgeTime( r_edgenum ) - t;
+            }
+            else
+            {
+                AcquirePass();
+
+                stats.acquire_edges += r_edgenum - r;
+                stats.acquire_time += EdgeTime( r_edgenum ) - t;
+            }
+
+            if ( checkpoint_due )
+            {
+                checkpoint_due = 0;
+                Save( &index->checkpoint[ index->ncheckpoints++ ] );
+            }
+        }
+    }
+
+    /* ---------------------------------------------------------------------------------------- */
+    /* API */
+    /* ---------------------------------------------------------------------------------------- */
+
+    void AddEdge(
+        uint64_t                         width )
+    {
+        PutEdge( w_edgenum, width );
+
+        w_edgenum++; /* no need to mask on increment */
+
+        //printf("edge: %d, %04lx, %04lx\n", dt[ (w_edgenum-1) & EDGE_MASK ], r_edgenum, w_edgenum  );
+
+        DecodeEdges();
+    }
+
+    /* same as calling AddEdge() for each of the n edge widths in turn */
+    template <typename In>
+    void AddEdges(
+        const In                        *widths,
+        size_t                           n )
+    {
+        while ( n > 0 )
+        {
+            size_t      room,i;
+            uint64_t    w = w_edgenum;
+            In          widest = 0;
+
+            /*
+             *  Fill the ring only up to the point where AddEdge() would have run the
+             *  decoder, so the thresholds see exactly the same window of edges.
+             */
+            room = WindowEdges - (size_t)(w - r_edgenum);
+            if ( room > n )
+                room = n;
+
+            n -= room;
+
+            /* nothing to saturate is by far the common case, keep its loop free of the check */
+            for ( i = 0; i < room; i++ )
+                widest = (widths[i] > widest) ? widths[i] : widest;
+
+            if ( (uint64_t)widest < (uint64_t)DT_MAX )
+            {
+                for ( i = 0; i < room; i++ )
+                {
+                    dt[ (w + i) & EDGE_MASK ] = (Dt)widths[i];
+                    TrackEdge( w + i, (Dt)widths[i] );
+                }
+            }
+            else
+            {
+                for ( i = 0; i < room; i++ )
+                    PutEdge( w + i, widths[i] );
+            }
+
+            widths += room;
+            w_edgenum = w + room;
+
+            DecodeEdges();
+        }
+    }
+
+    /*
+     *  The edges are about to stop (or jump), decode the whole subframes still
+     *  waiting in the window with the thresholds they were tracked with.  A
+     *  full window is needed for a pass, so they would be lost otherwise.
+     */
+    void Drain()
+    {
+        enum SpdifFrameType         synctype;
+        uint64_t                    n;
+        unsigned int                bits;
+
+        if ( sbs_track != state )
+            return;
+
+        ClassifyEdges( c_edgenum );
+
+        while ( ((w_edgenum - r_edgenum) >= 4) &&
+                (sft_invalid != (synctype = PreambleAt( r_edgenum ))) )
+        {
+            /* the last subframe may be cut short, count its edges (two per 1, one per 0) first */
+            for ( n = 4, bits = 0; (bits < 28) && (r_edgenum + n < w_edgenum); bits++ )
+                n += ( SBA_SYM_1 == sym[ (r_edgenum + n) & EDGE_MASK ] ) ? 2 : 1;
+
+            if ( (bits < 28) || (r_edgenum + n > w_edgenum) )
+                break;
+
+            DecodeSubframe( synctype );
+        }
+    }
+
+    /*
+     *  Most edges that can be added without decoding more than nsubframes.  A
+     *  subframe takes at least 32 edges off the read pointer (4 preamble + one
+     *  per bit) and the read pointer never passes the write pointer, so the
+     *  edges already waiting count against the budget too.
+     */
+    size_t EdgesFor(
+        size_t                           nsubframes ) const
+    {
+        size_t      pending = (size_t)(w_edgenum - r_edgenum);
+        size_t      budget = nsubframes << 5;
+
+        return( (budget > pending) ? (budget - pending) : 0 );
+    }
+
+    /* start over, keeping the sink */
+    void Reset()
+    {
+        Sink               *keep = sink;
+
+        memset( this, 0, sizeof(*this) );
+        sink = keep;
+    }
+
+    /*
+     *  Start over part way into a stream, the next edge added is edge edgenum
+     *  and starts at time.  Edge numbers and times come out as if every edge
+     *  before it had been added too.  edgenum has to be a multiple of
+     *  SBA_BLOCK_EDGES for the block summaries to line up.
+     */
+    void Seek(
+        uint64_t                         edgenum,
+        uint64_t                         time )
+    {
+        Reset();
+
+        w_edgenum = r_edgenum = c_edgenum = t_edgenum = edgenum;
+        t_time = time;
+    }
+
+    /* everything but the edge widths, see Restore() */
+    void Save(
+        struct SpdifDecoderCheckpoint   *cp ) const
+    {
+        cp->block = n_b_syncs ? (n_b_syncs - 1) : 0;
+        cp->w_edgenum = w_edgenum;
+        cp->r_edgenum = r_edgenum;
+        cp->c_edgenum = c_edgenum;
+        cp->t_edgenum = t_edgenum;
+        cp->t_time = t_time;
+        cp->n_syncs = n_syncs;
+        cp->sync_start_time = sync_start_time;
+        cp->sync_end_time = sync_end_time;
+        cp->prev_b_dt = prev_b_dt;
+        cp->prev_b_nsyncs = prev_b_nsyncs;
+        cp->n_b_syncs = n_b_syncs;
+        cp->last_b_sync = last_b_sync;
+        cp->last_b_time = last_b_time;
+        cp->lost_edgenum = lost_edgenum;
+        cp->lost_time = lost_time;
+        cp->last_threshold_12 = last_threshold_12;
+        cp->last_threshold_23 = last_threshold_23;
+        cp->threshold_12 = threshold_12;
+        cp->threshold_23 = threshold_23;
+        cp->good_threshold_12 = good_threshold_12;
+        cp->good_threshold_23 = good_threshold_23;
+        cp->state = (int) state;
+        cp->since_refresh = since_refresh;
+        cp->lost_sync = lost_sync;
+        cp->sample = sample;
+        cp->channel_status_left_bits = channel_status_left_bits;
+        cp->channel_status_right_bits = channel_status_right_bits;
+        cp->stats = stats;
+        cp->cur_cs = cur_cs;
+        cp->prev_cs = prev_cs;
+    }
+
+    /*
+     *  Back to the state cp was saved in.  widths holds every edge of the stream
+     *  from edge 0, the ring is refilled from the ones it held, and sym[] is
+     *  classified again, it only ever holds the edges classified with the
+     *  current thresholds.  Keeps the sink and index.
+     */
+    template <typename In>
+    void Restore(
+        const struct SpdifDecoderCheckpoint *cp,
+        const In                        *widths )
+    {
+        struct SpdifBlockIndex *keep = index;
+        uint64_t        e;
+
+        Reset();
+        index = keep;
+
+        /* from the start of the block summary r_edgenum is in */
+        for ( e = cp->r_edgenum & ~(uint64_t)SBA_BLOCK_MASK; e < cp->w_edgenum; e++ )
+            PutEdge( e, widths[e] );
+
+        w_edgenum = cp->w_edgenum;
+        r_edgenum = cp->r_edgenum;
+        t_edgenum = cp->t_edgenum;
+        t_time = cp->t_time;
+        n_syncs = cp->n_syncs;
+        sync_start_time = cp->sync_start_time;
+        sync_end_time = cp->sync_end_time;
+        prev_b_dt = cp->prev_b_dt;
+        prev_b_nsyncs = cp->prev_b_nsyncs;
+        n_b_syncs = cp->n_b_syncs;
+        last_b_sync = cp->last_b_sync;
+        last_b_time = cp->last_b_time;
+        lost_edgenum = cp->lost_edgenum;
+        lost_time = cp->lost_time;
+        last_threshold_12 = (Dt) cp->last_threshold_12;
+        last_threshold_23 = (Dt) cp->last_threshold_23;
+        threshold_12 = (Dt) cp->threshold_12;
+        threshold_23 = (Dt) cp->threshold_23;
+        good_threshold_12 = (Dt) cp->good_threshold_12;
+        good_threshold_23 = (Dt) cp->good_threshold_23;
+        state = (enum SbaState) cp->state;
+        since_refresh = cp->since_refresh;
+        lost_sync = cp->lost_sync;
+        sample = cp->sample;
+        channel_status_left_bits = cp->channel_status_left_bits;
+        channel_status_right_bits = cp->channel_status_right_bits;
+        stats = cp->stats;
+        cur_cs = cp->cur_cs;
+        prev_cs = cp->prev_cs;
+
+        ClassifyEdges( r_edgenum );
+        c_edgenum = cp->c_edgenum;
+    }
+
+    /*
+     *  True when this decoder and o, having been fed the same edges up to
+     *  w_edgenum, will make exactly the same callbacks from here on whatever
+     *  edges follow.  Counters and stats are not compared, they do not steer
+     *  the decode.
+     */
+    bool SameCourse(
+        const SpdifDecoder              &o ) const
+    {
+        uint64_t        e;
+
+        if ( (w_edgenum != o.w_edgenum) ||
+             (r_edgenum != o.r_edgenum) ||
+             (c_edgenum != o.c_edgenum) ||
+             (state != o.state) ||
+             (threshold_12 != o.threshold_12) ||
+             (threshold_23 != o.threshold_23) ||
+             (good_threshold_12 != o.good_threshold_12) ||
+             (good_threshold_23 != o.good_threshold_23) ||
+             (since_refresh != o.since_refresh) ||
+             (lost_sync != o.lost_sync) )
+            return false;
+
+        if ( lost_sync &&
+             ((lost_edgenum != o.lost_edgenum) || (lost_time != o.lost_time)) )
+            return false;
+
+        /* the next B makes a status callback only if one was seen before it */
+        if ( (0 == n_b_syncs) != (0 == o.n_b_syncs) )
+            return false;
+
+        if ( n_b_syncs &&
+             ((last_b_time != o.last_b_time) ||
+              (channel_status_left_bits != o.channel_status_left_bits) ||
+              (channel_status_right_bits != o.channel_status_right_bits) ||
+              memcmp( &cur_cs, &o.cur_cs, sizeof(cur_cs) )) )
+            return false;
+
+        /* edges already classified are not classified again until the next refresh */
+        for ( e = r_edgenum; e < c_edgenum; e++ )
+        {
+            if ( sym[ e & EDGE_MASK ] != o.sym[ e & EDGE_MASK ] )
+                return false;
+        }
+
+        return true;
+    }
+};
+
+/*
+ *  Front end for captures of raw samples rather than edges, 1 bit per sample
+ *  packed 64 to a word, the first sample in bit 0.  Each sample is XORed with
+ *  the one before it by shifting the word up a bit and bringing in the last
+ *  sample of the word before, which leaves a bit set wherever the line
+ *  changed.  Those are taken lowest first with a count of trailing zeros, so
+ *  the cost is per edge and not per sample, and a word with no edge in it is
+ *  a single compare.  Widths are in samples, the first one from sample 0.
+ */
+
+/* room Find() needs past the widths it returns */
+#define SBA_EDGES_SLACK     4
+
+struct SpdifBitEdges
+{
+    uint64_t    sample;     /* samples taken so far */
+    uint64_t    edge;       /* the sample the last edge was on */
+    uint64_t    level;      /* the last sample taken */
+    int         started;    /* 0 until the first sample, which is not an edge */
+
+    void Reset()
+    {
+        sample = 0;
+        edge = 0;
+        level = 0;
+        started = 0;
+    }
+
+    /* the widths of the edges in x, which has a bit set per edge and starts at sample at */
+    static inline uint64_t *Widths( uint64_t *widths, uint64_t x, uint64_t at, uint64_t *prev )
+    {
+#if defined(SBA_EDGES_POPCNT)
+        /*
+         *  Four at a time without a branch each, the loop runs ceil(edges/4)
+         *  times.  Bit 63 keeps the count defined once x runs out, the extra
+         *  widths land in the slack and are overwritten by the next word, so
+         *  the last edge is taken from the highest bit of x instead.
+         */
+        const uint64_t  top = 1ULL << 63;
+        uint64_t       *end = widths + sba_Popcount64( x );
+        uint64_t        last_x = x;
+        uint64_t        e0 = *prev;
+
+        while ( widths < end )
+        {
+            uint64_t    e1,e2,e3,e4;
+
+            e1 = at + sba_Ctz64( x | top );     x &= x - 1;
+            e2 = at + sba_Ctz64( x | top );     x &= x - 1;
+            e3 = at + sba_Ctz64( x | top );     x &= x - 1;
+            e4 = at + sba_Ctz64( x | top );     x &= x - 1;
+
+            widths[0] = e1 - e0;
+            widths[1] = e2 - e1;
+            widths[2] = e3 - e2;
+            widths[3] = e4 - e3;
+
+            e0 = e4;
+            widths += 4;
+        }
+
+        if ( 0 != last_x )
+            *prev = at + 63 - sba_Clz64( last_x );
+
+        return(end);
+#else
+        uint64_t    e0 = *prev;
+
+        while ( 0 != x )
+        {
+            uint64_t    e1 = at + sba_Ctz64( x );
+
+            *widths++ = e1 - e0;
+            e0 = e1;
+            x &= x - 1;
+        }
+
+        *prev = e0;
+        return(widths);
+#endif
+    }
+
+    /*
+     *  The widths of the edges in the next nsamples samples, which start at bit 0
+     *  of words[0].  widths needs room for nsamples + SBA_EDGES_SLACK of them.
+     *  Returns how many there are.
+     */
+    size_t Find(
+        const uint64_t                  *words,
+        size_t                           nsamples,
+        uint64_t                        *widths )
+    {
+        size_t      nwords = nsamples >> 6;
+        size_t      i;
+        uint64_t   *end = widths;
+        uint64_t    at = sample;
+        uint64_t    carry = level;
+        uint64_t    prev = edge;
+
+        if ( 0 == nsamples )
+            return(0);
+
+        if ( !started )
+        {
+            carry = words[0] & 1;
+            started = 1;
+        }
+
+        for ( i = 0; i < nwords; i++, at += 64 )
+        {
+            uint64_t    w = words[i];
+
+            end = Widths( end, w ^ ((w << 1) | carry), at, &prev );
+            carry = w >> 63;
+        }
+
+        /* the samples in a last, part filled word */
+        if ( 0 != (nsamples & 63) )
+        {
+            unsigned int    nbits = (unsigned int)( nsamples & 63 );
+            uint64_t        mask = (1ULL << nbits) - 1;
+            uint64_t        w = words[nwords] & mask;
+
+            end = Widths( end, (w ^ ((w << 1) | carry)) & mask, at, &prev );
+            carry = (w >> (nbits - 1)) & 1;
+        }
+
+        sample += nsamples;
+        edge = prev;
+        level = carry;
+
+        return( (size_t)( end - widths ) );
+    }
+};
+
+/*
+ *  Sink that appends subframes to a struct SpdifSubframeBuffer.  Subframes
+ *  past its capacity are counted in dropped, size the input with EdgesFor()
+ *  so there are none.
+ */
+struct SpdifSubframeWriter
+{
+    struct SpdifSubframeBuffer  *buf;
+    uint64_t                     prev_end;  /* end of the previous subframe, 0 before the first */
+    int                          relocked;
+    int                          suspect;   /* suspect_callback() seen since the last subframe */
+    int                          block;     /* status_callback() seen since the last subframe */
+    uint64_t                     dropped;
+
+    void sample_callback( uint64_t t, uint64_t tend, enum SpdifFrameType ft, uint32_t aud_sample )
+    {
+        size_t          i = buf->count;
+        uint32_t        parity = aud_sample >> 4;
+        unsigned char   flags = 0;
+
+        if ( i >= buf->capacity )
+        {
+            dropped++;
+            return;
+        }
+
+        /* bits 4-31 carry even parity */
+        parity ^= parity >> 16;
+        parity ^= parity >> 8;
+        parity ^= parity >> 4;
+        parity ^= parity >> 2;
+        parity ^= parity >> 1;
+
+        if ( parity & 1 )
+            flags |= SPDIF_SF_PARITY;
+
+        if ( (0 != prev_end) && (prev_end != t) )
+            flags |= SPDIF_SF_GAP;
+
+        if ( relocked )
+            flags |= SPDIF_SF_RELOCK;
+
+        if ( suspect )
+            flags |= SPDIF_SF_SUSPECT;
+
+        if ( block )
+            flags |= SPDIF_SF_BLOCK;
+
+        buf->t_start[i] = t;
+        buf->t_end[i] = tend;
+        buf->type[i] = (unsigned char) ft;
+        buf->raw[i] = aud_sample;
+        buf->flags[i] = flags;
+        buf->count = i + 1;
+
+        prev_end = tend;
+        relocked = 0;
+        suspect = 0;
+        block = 0;
+    }
+
+    void status_callback( uint64_t, uint64_t, struct SpdifChannelStatus * )
+    {
+        block = 1;
+    }
+
+    void relock_callback( uint64_t, uint64_t, uint32_t )
+    {
+        relocked = 1;
+    }
+
+    void suspect_callback( uint64_t, uint64_t )
+    {
+        suspect = 1;
+    }
+};
+
+#endif /* SPDIF_DECODER_H */
@@ -3,30 +3,69 @@
 
 #include <stdint.h>
 
+/*
+ *  The header is laid out for RF64 (EBU Tech 3306) from the start.  A file
+ *  that fits in 4 GB keeps "RIFF" and a "JUNK" chunk where the "ds64" chunk
+ *  goes, a larger one becomes "RF64" with the real sizes in "ds64" and
+ *  0xffffffff in the 32-bit ones.  Samples over 16 bits are
+ *  WAVE_FORMAT_EXTENSIBLE, 16-bit ones a plain 16-byte PCM "fmt " and a
+ *  "JUNK" chunk in the rest of the room, so "data" is always at the same place.
+ */
+#pragma pack(push,1)
+
 struct WAVHeader
 {
-    char        wh_RIFF[4];     /* "RIFF" */
+    char        wh_RIFF[4];     /* "RIFF", or "RF64" */
 
     uint32_t    wh_len;         /* total file size -8 */
 
     char        wh_WAVE[4];     /* "WAVE" */
 
+    char        wh_ds64[4];     /* "JUNK", or "ds64" */
+
+    uint32_t    wh_ds64len;     /* ds64 length (==28) */
+
+    uint64_t    wh_riffsize;    /* total file size -8, RF64 only */
+    uint64_t    wh_datasize;    /* data length, RF64 only */
+    uint64_t    wh_samplecount; /* samples per channel, RF64 only */
+    uint32_t    wh_tablelen;    /* no table of other chunk sizes, 0 */
+
     char        wh_fmt_[4];     /* "fmt " */
 
-    uint32_t    wh_fmtlen;      /* format length (==16) */
+    uint32_t    wh_fmtlen;      /* format length, 40 extensible or 16 PCM */
 
-    uint16_t    wh_format;      /* format specifier, 1==PCM */
+    uint16_t    wh_format;      /* format specifier, 1==PCM, 0xfffe==WAVE_FORMAT_EXTENSIBLE */
     uint16_t    wh_chans;       /* number of channels, 2 */
 
-    uint32_t    wh_samprate;    /* sample rate, 48000 */
+    uint32_t    wh_samprate;    /* sample rate */
     uint32_t    wh_bytespersec; /* bytes per second, */
 
     uint16_t    wh_bytespersmp; /* bytes per sample */
-    uint16_t    wh_bitsperchan; /* bits per channel */
+    uint16_t    wh_bitsperchan; /* bits per channel, 16 or 24 */
+
+    union
+    {
+        struct                      /* WAVE_FORMAT_EXTENSIBLE */
+        {
+            uint16_t    cbsize;     /* extension length (==22) */
+            uint16_t    validbits;  /* bits used per channel, 20 or 24 */
+            uint32_t    chanmask;   /* front left | front right */
+            unsigned char subformat[16]; /* KSDATAFORMAT_SUBTYPE_PCM */
+        }           ext;
+
+        struct                      /* PCM, the fmt chunk has ended */
+        {
+            char        junk[4];    /* "JUNK" */
+            uint32_t    junklen;    /* (==16) */
+            unsigned char pad[16];
+        }           pcm;
+    }           wh_fmtx;
 
     char        wh_data[4];     /* "data" */
 
     uint32_t    wh_dlen;        /* data length */
 };
 
+#pragma pack(pop)
+
 #endif /* WAVHDR_H */
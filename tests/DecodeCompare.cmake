@@ -0,0 +1,35 @@
+# decodes CAPTURE with DECODER on THREADS threads and compares the raw subframes
+# with GOLDEN, run as cmake -P from the tests CMake adds; RATE, when set, is the
+# sample rate the capture's times are read at
+#
+# A change that is meant to alter the decode regenerates the golden file with
+#   spdif_decode -q -j 1 -r tests/data/glitches.raw tests/data/glitches.trc
+
+foreach(var DECODER THREADS CAPTURE GOLDEN OUT)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} is not set")
+    endif()
+endforeach()
+
+set(rate_args)
+if(DEFINED RATE)
+    set(rate_args -s ${RATE})
+endif()
+
+file(REMOVE ${OUT})
+
+execute_process(
+    COMMAND ${DECODER} -q -j ${THREADS} ${rate_args} -r ${OUT} ${CAPTURE}
+    RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "spdif_decode -j ${THREADS} failed: ${result}")
+endif()
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${OUT} ${GOLDEN}
+    RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "decoding ${CAPTURE} on ${THREADS} threads no longer gives ${GOLDEN}")
+endif()
@@ -0,0 +1,31 @@
+# runs the SELF_TEST decoder DECODER on the "sample, level" CSV CAPTURE and compares
+# the raw subframes it writes with GOLDEN, run as cmake -P from the test CMake adds
+#
+# A change that is meant to alter the decode regenerates GOLDEN with
+#   spdif_selftest tests/data/glitches_selftest.raw < tests/data/glitches.csv
+
+foreach(var DECODER CAPTURE GOLDEN OUT)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} is not set")
+    endif()
+endforeach()
+
+file(REMOVE ${OUT})
+
+execute_process(
+    COMMAND ${DECODER} ${OUT}
+    INPUT_FILE ${CAPTURE}
+    OUTPUT_QUIET
+    RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${DECODER} failed: ${result}")
+endif()
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${OUT} ${GOLDEN}
+    RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "decoding ${CAPTURE} no longer gives ${GOLDEN}")
+endif()
@@ -0,0 +1,217 @@
+/*
+
+  GPL LICENSE SUMMARY
+
+  Copyright(c) Pat Brouillette. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of version 2 of the GNU General Public License as
+  published by the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+  The full GNU General Public License is included in this distribution
+  in the file called LICENSE.GPL.
+
+  Contact Information:
+    Pat Brouillette  pfrench@acm.org
+
+*/
+
+
+/*
+ *  capture_convert <capture> <out prefix>, writes the capture's line again as
+ *  the other kinds of file spdif_decode reads:
+ *
+ *    <prefix>_seconds.csv  a Logic export, times in seconds
+ *    <prefix>.vcd          times in nanoseconds
+ *    <prefix>.bin          a Logic 2 binary export
+ *
+ *  The capture's rate must be known and the times are written exactly at it,
+ *  so read back at that rate every file decodes as the capture does.  Last
+ *  <prefix>_backwards.bin has transition BACKWARDS_TRANSITION at the time of
+ *  the one before it, which spdif_decode must turn down.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "spdifCapture.h"
+
+/* the transition given the time of the one before it in <prefix>_backwards.bin */
+#define BACKWARDS_TRANSITION    1000
+
+/* the capture tick of every edge, the origin first */
+static void edge_ticks( const struct spdifCapture *cap, std::vector<uint64_t> *ticks )
+{
+    uint64_t    t = 0;
+    size_t      e;
+
+    ticks->reserve( cap->dt.size() + 1 );
+    ticks->push_back( cap->origin );
+
+    for ( e = 0; e < cap->dt.size(); e++ )
+    {
+        t += cap->dt[e];
+        ticks->push_back( capture_Sample( cap, t ) );
+    }
+}
+
+/* tick in seconds, to the nanosecond */
+static void print_seconds( FILE *fp, uint64_t tick, uint64_t rate )
+{
+    fprintf( fp, "%llu.%09llu", (unsigned long long)(tick / rate),
+             (unsigned long long)((tick % rate) * 1000000000ULL / rate) );
+}
+
+static int write_csv( const char *path, const struct spdifCapture *cap, const std::vector<uint64_t> &ticks )
+{
+    FILE           *fp = fopen( path, "w" );
+    unsigned int    level = cap->level;
+    size_t          i;
+
+    if ( NULL == fp )
+        return(-1);
+
+    fprintf( fp, "Time [s],Channel 0\n" );
+    for ( i = 0; i < ticks.size(); i++, level ^= 1 )
+    {
+        print_seconds( fp, ticks[i], cap->rate );
+        fprintf( fp, ",%u\n", level );
+    }
+
+    return( fclose( fp ) );
+}
+
+static int write_vcd( const char *path, const struct spdifCapture *cap, const std::vector<uint64_t> &ticks )
+{
+    FILE           *fp = fopen( path, "w" );
+    unsigned int    level = cap->level;
+    size_t          i;
+
+    if ( NULL == fp )
+        return(-1);
+
+    fprintf( fp, "$date capture_convert $end\n"
+                 "$timescale 1 ns $end\n"
+                 "$scope module top $end\n"
+                 "$var wire 1 ! spdif $end\n"
+                 "$upscope $end\n"
+                 "$enddefinitions $end\n" );
+
+    for ( i = 0; i < ticks.size(); i++, level ^= 1 )
+        fprintf( fp, "#%llu\n%u!\n", (unsigned long long)(ticks[i] * 1000000000ULL / cap->rate), level );
+
+    return( fclose( fp ) );
+}
+
+/* Logic 2 binary, version 0 of a digital channel, times in seconds */
+static int write_bin( const char *path, const struct spdifCapture *cap, const std::vector<double> &times )
+{
+    FILE       *fp = fopen( path, "wb" );
+    int32_t     version = 0;
+    int32_t     type = 0;
+    uint32_t    initial = cap->level;
+    double      begin = (double) cap->origin / (double) cap->rate;
+    double      end = times.empty() ? begin : times.back();
+    uint64_t    n = times.size();
+    int         err = 0;
+
+    if ( NULL == fp )
+        return(-1);
+
+    if ( (1 != fwrite( "<SALEAE>", 8, 1, fp )) ||
+         (1 != fwrite( &version, sizeof(version), 1, fp )) ||
+         (1 != fwrite( &type, sizeof(type), 1, fp )) ||
+         (1 != fwrite( &initial, sizeof(initial), 1, fp )) ||
+         (1 != fwrite( &begin, sizeof(begin), 1, fp )) ||
+         (1 != fwrite( &end, sizeof(end), 1, fp )) ||
+         (1 != fwrite( &n, sizeof(n), 1, fp )) ||
+         (n != fwrite( times.data(), sizeof(double), (size_t) n, fp )) )
+        err = -1;
+
+    if ( 0 != fclose( fp ) )
+        err = -1;
+
+    return( err );
+}
+
+int main( int argc, char *argv[] )
+{
+    struct spdifCapture             cap;
+    struct spdifReadOptions         ro;
+    std::vector<uint64_t>           ticks;
+    std::vector<double>             times;
+    std::string                     prefix;
+    size_t                          i;
+
+    if ( argc < 3 )
+    {
+        fprintf( stderr, "usage: capture_convert <capture> <out prefix>\n" );
+        return( 2 );
+    }
+
+    capture_Init( &cap );
+    memset( &ro, 0, sizeof(ro) );
+    if ( 0 != capture_Read( &cap, argv[1], &ro ) )
+        return( 1 );
+
+    if ( (0 == cap.rate) || (1000000000ULL % cap.rate) )
+    {
+        fprintf( stderr, "%s: a rate of %llu Hz can not be written to the nanosecond\n", argv[1],
+                 (unsigned long long) cap.rate );
+        return( 1 );
+    }
+
+    edge_ticks( &cap, &ticks );
+    prefix = argv[2];
+
+    if ( 0 != write_csv( (prefix + "_seconds.csv").c_str(), &cap, ticks ) )
+    {
+        fprintf( stderr, "can not write %s_seconds.csv\n", argv[2] );
+        return( 1 );
+    }
+
+    if ( 0 != write_vcd( (prefix + ".vcd").c_str(), &cap, ticks ) )
+    {
+        fprintf( stderr, "can not write %s.vcd\n", argv[2] );
+        return( 1 );
+    }
+
+    /* the transitions, the origin is begin_time */
+    for ( i = 1; i < ticks.size(); i++ )
+        times.push_back( (double) ticks[i] / (double) cap.rate );
+
+    if ( 0 != write_bin( (prefix + ".bin").c_str(), &cap, times ) )
+    {
+        fprintf( stderr, "can not write %s.bin\n", argv[2] );
+        return( 1 );
+    }
+
+    if ( times.size() <= BACKWARDS_TRANSITION )
+    {
+        fprintf( stderr, "%s: too few edges to put one back\n", argv[1] );
+        return( 1 );
+    }
+
+    times[BACKWARDS_TRANSITION] = times[BACKWARDS_TRANSITION - 1];
+
+    if ( 0 != write_bin( (prefix + "_backwards.bin").c_str(), &cap, times ) )
+    {
+        fprintf( stderr, "can not write %s_backwards.bin\n", argv[2] );
+        return( 1 );
+    }
+
+    printf( "%llu edges at %llu Hz\n", (unsigned long long) cap.dt.size(), (unsigned long long) cap.rate );
+    return(0);
+}
@@ -0,0 +1,105 @@
+/*
+
+  GPL LICENSE SUMMARY
+
+  Copyright(c) Pat Brouillette. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of version 2 of the GNU General Public License as
+  published by the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+  The full GNU General Public License is included in this distribution
+  in the file called LICENSE.GPL.
+
+  Contact Information:
+    Pat Brouillette  pfrench@acm.org
+
+*/
+
+/*
+ *  channel_status_test, channel status blocks as the decoder stores them,
+ *  bit n in bit (n & 7) of byte (n >> 3), must give the sample rate that
+ *  IEC 60958-3 assigns to their rate bits.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "spdif.h"
+
+struct rate_case
+{
+    const char      *bits;      /* consumer bits 24-27, or professional bits 6-7, in order */
+    uint32_t         rate;
+};
+
+static int  failures;
+
+/* a channel status block with bits[0] at bit first, bits[1] at first+1 ... */
+static void set_bits( unsigned char *cs, unsigned int first, const char *bits )
+{
+    for ( unsigned int n = first; *bits; n++, bits++ )
+    {
+        if ( '1' == *bits )
+            cs[ n >> 3 ] |= 1 << (n & 7);
+    }
+}
+
+static void check( const char *what, const unsigned char *cs, const char *bits, uint32_t want )
+{
+    uint32_t    got = SpdifChannelStatus_Rate( cs );
+
+    if ( got != want )
+    {
+        fprintf( stderr, "%s %s: %u, expected %u\n", what, bits, got, want );
+        failures++;
+    }
+}
+
+int main( int, char ** )
+{
+    static const struct rate_case   consumer[] =
+    {
+        { "0000",  44100 }, { "0100",  48000 }, { "1100",  32000 },
+        { "0010",  22050 }, { "0110",  24000 }, { "0001",  88200 },
+        { "0101",  96000 }, { "0011", 176400 }, { "0111", 192000 },
+        { "1001", 768000 }, { "1000",      0 }, { "1111",      0 },
+    };
+    static const struct rate_case   professional[] =
+    {
+        { "00", 0 }, { "01", 48000 }, { "10", 44100 }, { "11", 32000 },
+    };
+    unsigned char                   cs[CHANNEL_STATUS_NBYTES];
+    size_t                          i;
+
+    for ( i = 0; i < sizeof(consumer)/sizeof(consumer[0]); i++ )
+    {
+        memset( cs, 0, sizeof(cs) );
+        set_bits( cs, 24, consumer[i].bits );
+        check( "consumer", cs, consumer[i].bits, consumer[i].rate );
+    }
+
+    for ( i = 0; i < sizeof(professional)/sizeof(professional[0]); i++ )
+    {
+        memset( cs, 0, sizeof(cs) );
+        set_bits( cs, 0, "1" );     /* professional */
+        set_bits( cs, 6, professional[i].bits );
+        check( "professional", cs, professional[i].bits, professional[i].rate );
+    }
+
+    /* the other bits of byte 3, clock accuracy, do not change the rate */
+    memset( cs, 0, sizeof(cs) );
+    set_bits( cs, 24, "01001100" );
+    check( "consumer with clock accuracy", cs, "01001100", 48000 );
+
+    return( failures ? 1 : 0 );
+}
@@ -0,0 +1,272 @@
+/*
+
+  GPL LICENSE SUMMARY
+
+  Copyright(c) Pat Brouillette. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of version 2 of the GNU General Public License as
+  published by the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+  The full GNU General Public License is included in this distribution
+  in the file called LICENSE.GPL.
+
+  Contact Information:
+    Pat Brouillette  pfrench@acm.org
+
+*/
+
+/*
+ *  checkpoint_test <capture>, decodes the capture once with a block index,
+ *  checks what SpdifBlockIndex_Find() and SpdifBlockIndex_Checkpoint() say
+ *  about it, then restores every checkpoint in turn and checks that the
+ *  subframes and channel status blocks from there on are the ones the
+ *  decode straight through gave.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "spdif.h"
+#include "spdifCapture.h"
+
+/* blocks between checkpoints, small so a short capture still has several */
+#define CHECKPOINT_INTERVAL     2
+
+/* most blocks and checkpoints indexed */
+#define CHECKPOINT_MAX_BLOCKS   1024
+
+static int  failures;
+
+static void check( int ok, const char *what, unsigned long long got, unsigned long long want )
+{
+    if ( !ok )
+    {
+        fprintf( stderr, "%s: %llu, expected %llu\n", what, got, want );
+        failures++;
+    }
+}
+
+/* the subframes and channel status blocks a decoder gave */
+struct decodeOutput
+{
+    std::vector<uint64_t>           t_start;
+    std::vector<uint64_t>           t_end;
+    std::vector<unsigned char>      type;
+    std::vector<uint32_t>           raw;
+    std::vector<unsigned char>      flags;
+    std::vector<uint64_t>           status_end;
+    struct SpdifSubframeBuffer      buf;
+
+    void Init( size_t capacity )
+    {
+        t_start.resize( capacity );
+        t_end.resize( capacity );
+        type.resize( capacity );
+        raw.resize( capacity );
+        flags.resize( capacity );
+        status_end.clear();
+
+        buf.t_start = &t_start[0];
+        buf.t_end = &t_end[0];
+        buf.type = &type[0];
+        buf.raw = &raw[0];
+        buf.flags = &flags[0];
+        buf.capacity = capacity;
+        buf.count = 0;
+    }
+};
+
+/* buffered mode still reports the channel status blocks here */
+static void status_callback( void *userdata, uint64_t, uint64_t tend, struct SpdifChannelStatus * )
+{
+    ((struct decodeOutput *) userdata)->status_end.push_back( tend );
+}
+
+static struct SpdifBitstreamAnalyzer *create( struct decodeOutput *out, size_t capacity )
+{
+    struct SpdifBitstreamCallbacks  cb;
+    struct SpdifBitstreamAnalyzer   *sba;
+
+    memset( &cb, 0, sizeof(cb) );
+    cb.userdata = out;
+    cb.cb_status = status_callback;
+
+    out->Init( capacity );
+
+    if ( NULL != (sba = SpdifBitstreamAnalyzer_Create( &cb )) )
+        SpdifBitstreamAnalyzer_SetSubframeBuffer( sba, &out->buf );
+
+    return( sba );
+}
+
+/* restored from cp, what comes out must be serial's from just after cp's B subframe */
+static void check_restore(
+    const struct spdifCapture           *cap,
+    const struct SpdifDecoderCheckpoint *cp,
+    struct SpdifBlockIndex              *index,
+    const struct decodeOutput           *serial )
+{
+    struct decodeOutput             out;
+    struct SpdifBitstreamAnalyzer   *sba = create( &out, serial->buf.capacity );
+    size_t                          nblocks = index->nblocks;
+    size_t                          ncheckpoints = index->ncheckpoints;
+    size_t                          s,i;
+    uint64_t                        e;
+
+    if ( NULL == sba )
+    {
+        check( 0, "create", 0, 1 );
+        return;
+    }
+
+    /* decoding over indexed blocks again must leave the index as it is */
+    SpdifBitstreamAnalyzer_SetBlockIndex( sba, index );
+
+    e = SpdifBitstreamAnalyzer_Restore( sba, cp, &cap->dt[0] );
+    check( e == cp->w_edgenum, "restore edge", e, cp->w_edgenum );
+    SpdifBitstreamAnalyzer_AddEdges( sba, &cap->dt[e], cap->dt.size() - e );
+
+    check( index->nblocks == nblocks, "blocks indexed after a restore", index->nblocks, nblocks );
+    check( index->ncheckpoints == ncheckpoints, "checkpoints after a restore", index->ncheckpoints, ncheckpoints );
+
+    for ( s = 0; s < serial->buf.count; s++ )
+    {
+        if ( serial->t_start[s] == cp->sync_start_time )
+            break;
+    }
+    check( (s < serial->buf.count) && (sft_B == serial->type[s]), "B subframe of the checkpoint", s, serial->buf.count );
+    s++;
+
+    check( out.buf.count == serial->buf.count - s, "subframes after a restore", out.buf.count, serial->buf.count - s );
+
+    for ( i = 0; (i < out.buf.count) && (s + i < serial->buf.count); i++ )
+    {
+        if ( (out.t_start[i] != serial->t_start[s + i]) || (out.t_end[i] != serial->t_end[s + i]) ||
+             (out.type[i] != serial->type[s + i]) || (out.raw[i] != serial->raw[s + i]) ||
+             (out.flags[i] != serial->flags[s + i]) )
+        {
+            fprintf( stderr, "subframe %llu differs when restored from block %llu\n",
+                     (unsigned long long)(s + i), (unsigned long long) cp->block );
+            failures++;
+            break;
+        }
+    }
+
+    /* the status block of the checkpoint's B was reported before it was taken */
+    for ( s = 0; s < serial->status_end.size(); s++ )
+    {
+        if ( serial->status_end[s] > cp->sync_start_time )
+            break;
+    }
+
+    check( out.status_end.size() == serial->status_end.size() - s, "status blocks after a restore",
+           out.status_end.size(), serial->status_end.size() - s );
+    for ( i = 0; (i < out.status_end.size()) && (s + i < serial->status_end.size()); i++ )
+    {
+        if ( out.status_end[i] != serial->status_end[s + i] )
+        {
+            fprintf( stderr, "status block %llu differs when restored from block %llu\n",
+                     (unsigned long long)(s + i), (unsigned long long) cp->block );
+            failures++;
+            break;
+        }
+    }
+
+    SpdifBitstreamAnalyzer_Delete( sba );
+}
+
+int main( int argc, char *argv[] )
+{
+    struct spdifCapture             cap;
+    struct spdifReadOptions         ro;
+    struct decodeOutput             serial;
+    struct SpdifBitstreamAnalyzer   *sba;
+    std::vector<uint64_t>           block_time( CHECKPOINT_MAX_BLOCKS );
+    std::vector<SpdifDecoderCheckpoint> checkpoint( CHECKPOINT_MAX_BLOCKS );
+    struct SpdifBlockIndex          index;
+    size_t                          n;
+
+    if ( argc < 2 )
+    {
+        fprintf( stderr, "usage: checkpoint_test <capture>\n" );
+        return( 2 );
+    }
+
+    capture_Init( &cap );
+    memset( &ro, 0, sizeof(ro) );
+    if ( 0 != capture_Read( &cap, argv[1], &ro ) )
+        return( 1 );
+
+    /* the decode straight through, indexed */
+    memset( &index, 0, sizeof(index) );
+    index.block_time = &block_time[0];
+    index.block_capacity = block_time.size();
+    index.checkpoint = &checkpoint[0];
+    index.checkpoint_capacity = checkpoint.size();
+    index.interval = CHECKPOINT_INTERVAL;
+
+    if ( NULL == (sba = create( &serial, cap.dt.size() )) )
+        return( 1 );
+
+    SpdifBitstreamAnalyzer_SetBlockIndex( sba, &index );
+    SpdifBitstreamAnalyzer_AddEdges( sba, &cap.dt[0], cap.dt.size() );
+    SpdifBitstreamAnalyzer_Delete( sba );
+
+    if ( index.ncheckpoints < 2 )
+    {
+        fprintf( stderr, "%s: %llu blocks, not enough to test\n", argv[1], (unsigned long long) index.nblocks );
+        return( 1 );
+    }
+
+    check( index.ncheckpoints == (index.nblocks + CHECKPOINT_INTERVAL - 1) / CHECKPOINT_INTERVAL,
+           "checkpoints", index.ncheckpoints, (index.nblocks + CHECKPOINT_INTERVAL - 1) / CHECKPOINT_INTERVAL );
+
+    /* every block is found from the sample it starts at, and the one before it from just before */
+    check( 0 == SpdifBlockIndex_Find( &index, 0 ), "block at sample 0", SpdifBlockIndex_Find( &index, 0 ), 0 );
+    for ( n = 0; n < index.nblocks; n++ )
+    {
+        size_t  block = SpdifBlockIndex_Find( &index, index.block_time[n] );
+
+        check( block == n, "block found at its start", block, n );
+
+        if ( n && (index.block_time[n] - 1 >= index.block_time[n - 1]) )
+        {
+            block = SpdifBlockIndex_Find( &index, index.block_time[n] - 1 );
+            check( block == n - 1, "block found just before the next", block, n - 1 );
+        }
+    }
+
+    /* the checkpoint for a block is the last one taken at or before it */
+    for ( n = 0; n < index.nblocks + CHECKPOINT_INTERVAL; n++ )
+    {
+        const struct SpdifDecoderCheckpoint *cp = SpdifBlockIndex_Checkpoint( &index, n );
+        size_t                              i = n / CHECKPOINT_INTERVAL;
+
+        if ( i >= index.ncheckpoints )
+            i = index.ncheckpoints - 1;
+
+        check( cp == &index.checkpoint[i], "checkpoint for block", n, i * CHECKPOINT_INTERVAL );
+        check( cp->block == i * CHECKPOINT_INTERVAL, "block of checkpoint", cp->block, i * CHECKPOINT_INTERVAL );
+    }
+
+    for ( n = 0; n < index.ncheckpoints; n++ )
+        check_restore( &cap, &index.checkpoint[n], &index, &serial );
+
+    if ( 0 == failures )
+        printf( "%llu subframes, %llu blocks, %llu checkpoints restored\n", (unsigned long long) serial.buf.count,
+                (unsigned long long) index.nblocks, (unsigned long long) index.ncheckpoints );
+
+    return( failures ? 1 : 0 );
+}
@@ -0,0 +1,232 @@
+/*
+
+  GPL LICENSE SUMMARY
+
+  Copyright(c) Pat Brouillette. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of version 2 of the GNU General Public License as
+  published by the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+  The full GNU General Public License is included in this distribution
+  in the file called LICENSE.GPL.
+
+  Contact Information:
+    Pat Brouillette  pfrench@acm.org
+
+*/
+
+/*
+ *  packed_samples_test <capture> <out.bin>, samples the capture's line at its
+ *  tick rate into out.bin, 1 bit per sample as spdif_decode -p reads it.  The
+ *  subframes SpdifBitstreamAnalyzer_AddSamples() decodes from those samples,
+ *  given in chunks that end part way through words, must be the ones the
+ *  edges capture_Read() finds in out.bin decode to.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "spdif.h"
+#include "spdifCapture.h"
+
+static int  failures;
+
+static void check( int ok, const char *what, unsigned long long got, unsigned long long want )
+{
+    if ( !ok )
+    {
+        fprintf( stderr, "%s: %llu, expected %llu\n", what, got, want );
+        failures++;
+    }
+}
+
+/* the subframes a decoder gave */
+struct decodeOutput
+{
+    std::vector<uint64_t>           t_start;
+    std::vector<uint64_t>           t_end;
+    std::vector<unsigned char>      type;
+    std::vector<uint32_t>           raw;
+    std::vector<unsigned char>      flags;
+    struct SpdifSubframeBuffer      buf;
+
+    void Init( size_t capacity )
+    {
+        t_start.resize( capacity );
+        t_end.resize( capacity );
+        type.resize( capacity );
+        raw.resize( capacity );
+        flags.resize( capacity );
+
+        buf.t_start = &t_start[0];
+        buf.t_end = &t_end[0];
+        buf.type = &type[0];
+        buf.raw = &raw[0];
+        buf.flags = &flags[0];
+        buf.capacity = capacity;
+        buf.count = 0;
+    }
+};
+
+static void status_callback( void *, uint64_t, uint64_t, struct SpdifChannelStatus * )
+{
+}
+
+static struct SpdifBitstreamAnalyzer *create( struct decodeOutput *out, size_t capacity )
+{
+    struct SpdifBitstreamCallbacks  cb;
+    struct SpdifBitstreamAnalyzer   *sba;
+
+    memset( &cb, 0, sizeof(cb) );
+    cb.cb_status = status_callback;
+
+    out->Init( capacity );
+
+    if ( NULL != (sba = SpdifBitstreamAnalyzer_Create( &cb )) )
+        SpdifBitstreamAnalyzer_SetSubframeBuffer( sba, &out->buf );
+
+    return( sba );
+}
+
+/* n samples from sample from on, moved down to start at bit 0 of out[0] */
+static void take_samples( const std::vector<uint64_t> &words, uint64_t from, size_t n, std::vector<uint64_t> &out )
+{
+    unsigned int    shift = (unsigned int)(from & 63);
+    size_t          w = (size_t)(from >> 6);
+    size_t          i;
+
+    out.assign( (n + 63) >> 6, 0 );
+
+    for ( i = 0; i < out.size(); i++, w++ )
+    {
+        out[i] = words[w] >> shift;
+        if ( shift && (w + 1 < words.size()) )
+            out[i] |= words[w + 1] << (64 - shift);
+    }
+}
+
+int main( int argc, char *argv[] )
+{
+    /* none a multiple of 64, and some across the decoder's batches */
+    static const size_t             chunk[] = { 1, 63, 65, 127, 1000, 4097, 12345, 65537, 3 };
+    struct spdifCapture             cap,pcap;
+    struct spdifReadOptions         ro;
+    struct decodeOutput             edges,samples;
+    struct SpdifBitstreamAnalyzer   *sba;
+    std::vector<uint64_t>           words;
+    std::vector<uint64_t>           part;
+    uint64_t                        t = 0;
+    uint64_t                        nsamples,from;
+    unsigned int                    level;
+    size_t                          e,s,k,n;
+    FILE                            *fp;
+
+    if ( argc < 3 )
+    {
+        fprintf( stderr, "usage: packed_samples_test <capture> <out.bin>\n" );
+        return( 2 );
+    }
+
+    capture_Init( &cap );
+    memset( &ro, 0, sizeof(ro) );
+    if ( 0 != capture_Read( &cap, argv[1], &ro ) )
+        return( 1 );
+
+    /* the line at every tick from the origin, whole bytes of it */
+    nsamples = capture_Sample( &cap, cap.t ) - cap.origin + 1;
+    nsamples = (nsamples + 7) & ~(uint64_t) 7;
+    words.assign( (size_t)((nsamples + 63) >> 6), 0 );
+
+    level = cap.level;
+    from = 0;
+    for ( e = 0; e <= cap.dt.size(); e++ )
+    {
+        uint64_t    edge = nsamples;
+        uint64_t    i;
+
+        if ( e < cap.dt.size() )
+        {
+            t += cap.dt[e];
+            edge = capture_Sample( &cap, t ) - cap.origin;
+        }
+
+        if ( level )
+        {
+            for ( i = from; i < edge; i++ )
+                words[ (size_t)(i >> 6) ] |= 1ULL << (i & 63);
+        }
+
+        from = edge;
+        level ^= 1;
+    }
+
+    if ( (NULL == (fp = fopen( argv[2], "wb" ))) ||
+         ((size_t)(nsamples >> 3) != fwrite( &words[0], 1, (size_t)(nsamples >> 3), fp )) ||
+         (0 != fclose( fp )) )
+    {
+        fprintf( stderr, "can not write %s\n", argv[2] );
+        return( 1 );
+    }
+
+    /* the edges spdif_decode -p finds, decoded in one go */
+    capture_Init( &pcap );
+    ro.packed = 1;
+    if ( 0 != capture_Read( &pcap, argv[2], &ro ) )
+        return( 1 );
+
+    check( pcap.dt.size() == cap.dt.size(), "edges in the packed samples", pcap.dt.size(), cap.dt.size() );
+
+    if ( NULL == (sba = create( &edges, pcap.dt.size() + 1 )) )
+        return( 1 );
+    SpdifBitstreamAnalyzer_AddEdges( sba, &pcap.dt[0], pcap.dt.size() );
+    SpdifBitstreamAnalyzer_Delete( sba );
+
+    /* and the samples themselves, a chunk at a time */
+    if ( NULL == (sba = create( &samples, pcap.dt.size() + 1 )) )
+        return( 1 );
+    for ( from = 0, k = 0; from < nsamples; from += n, k++ )
+    {
+        n = chunk[ k % (sizeof(chunk)/sizeof(chunk[0])) ];
+        if ( n > nsamples - from )
+            n = (size_t)(nsamples - from);
+
+        take_samples( words, from, n, part );
+        SpdifBitstreamAnalyzer_AddSamples( sba, &part[0], n );
+    }
+    SpdifBitstreamAnalyzer_Delete( sba );
+
+    check( samples.buf.count == edges.buf.count, "subframes from samples", samples.buf.count, edges.buf.count );
+    check( edges.buf.count > 0, "subframes from edges", edges.buf.count, 1 );
+
+    /* the edge decode clips idle gaps to 16 bits, the samples keep every tick */
+    for ( s = 0; (s < samples.buf.count) && (s < edges.buf.count); s++ )
+    {
+        if ( (samples.t_start[s] != capture_Sample( &pcap, edges.t_start[s] )) ||
+             (samples.t_end[s] != capture_Sample( &pcap, edges.t_end[s] )) ||
+             (samples.type[s] != edges.type[s]) || (samples.raw[s] != edges.raw[s]) ||
+             (samples.flags[s] != edges.flags[s]) )
+        {
+            fprintf( stderr, "subframe %llu at sample %llu differs from the edge decode\n",
+                     (unsigned long long) s, (unsigned long long) samples.t_start[s] );
+            failures++;
+            break;
+        }
+    }
+
+    if ( 0 == failures )
+        printf( "%llu samples, %llu subframes\n", (unsigned long long) nsamples, (unsigned long long) samples.buf.count );
+
+    return( failures ? 1 : 0 );
+}
@@ -0,0 +1,162 @@
+/*
+
+  GPL LICENSE SUMMARY
+
+  Copyright(c) Pat Brouillette. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of version 2 of the GNU General Public License as
+  published by the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+  The full GNU General Public License is included in this distribution
+  in the file called LICENSE.GPL.
+
+  Contact Information:
+    Pat Brouillette  pfrench@acm.org
+
+*/
+
+/*
+ *  wav_run_test <out.wav>, runs of one repeated subframe, the way the plugin
+ *  merges silence, must come out of the WAV writer as left/right pairs and
+ *  not as a frame per subframe.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "spdif.h"
+
+static int  failures;
+
+static void check( int ok, const char *what, unsigned long long got, unsigned long long want )
+{
+    if ( !ok )
+    {
+        fprintf( stderr, "%s: %llu, expected %llu\n", what, got, want );
+        failures++;
+    }
+}
+
+static uint32_t le32( const unsigned char *p )
+{
+    return( p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24) );
+}
+
+/* frames in the data chunk of a RIFF WAV file, or -1 */
+static long long wav_frames( const char *path )
+{
+    unsigned char   hdr[8];
+    unsigned int    block_align = 0;
+    FILE            *fp = fopen( path, "rb" );
+
+    if ( NULL == fp )
+        return( -1 );
+
+    if ( (1 != fread( hdr, 4, 1, fp )) || memcmp( hdr, "RIFF", 4 ) ||
+         (0 != fseek( fp, 12, SEEK_SET )) )
+    {
+        fclose( fp );
+        return( -1 );
+    }
+
+    while ( 1 == fread( hdr, sizeof(hdr), 1, fp ) )
+    {
+        uint32_t    len = le32( hdr + 4 );
+
+        if ( !memcmp( hdr, "fmt ", 4 ) )
+        {
+            unsigned char   fmt[16];
+
+            if ( (len < sizeof(fmt)) || (1 != fread( fmt, sizeof(fmt), 1, fp )) )
+                break;
+            block_align = fmt[12] | (fmt[13] << 8);
+            len -= sizeof(fmt);
+        }
+        else if ( !memcmp( hdr, "data", 4 ) )
+        {
+            fclose( fp );
+            return( block_align ? (long long)(len / block_align) : -1 );
+        }
+
+        if ( 0 != fseek( fp, len + (len & 1), SEEK_CUR ) )
+            break;
+    }
+
+    fclose( fp );
+    return( -1 );
+}
+
+int main( int argc, char *argv[] )
+{
+    static const enum SpdifFrameType    m_run[] = { sft_M, sft_W, sft_M, sft_W };
+    static const enum SpdifFrameType    w_run[] = { sft_W, sft_M, sft_W };
+    static const enum SpdifFrameType    b_run[] = { sft_B, sft_W, sft_M };
+    struct SpdifWavWriter               *wav;
+    uint64_t                            want = 0;
+    long long                           frames;
+    unsigned int                        k;
+
+    if ( argc < 2 )
+    {
+        fprintf( stderr, "usage: wav_run_test <out.wav>\n" );
+        return( 2 );
+    }
+
+    for ( k = 0; k < 4; k++ )
+        check( m_run[k] == SpdifRunFrameType( sft_M, k ), "M run type", SpdifRunFrameType( sft_M, k ), m_run[k] );
+    for ( k = 0; k < 3; k++ )
+        check( w_run[k] == SpdifRunFrameType( sft_W, k ), "W run type", SpdifRunFrameType( sft_W, k ), w_run[k] );
+    for ( k = 0; k < 3; k++ )
+        check( b_run[k] == SpdifRunFrameType( sft_B, k ), "B run type", SpdifRunFrameType( sft_B, k ), b_run[k] );
+
+    if ( NULL == (wav = SpdifWavWriter_Open( argv[1], 48000, SPDIF_WAV_BITS_16 )) )
+    {
+        fprintf( stderr, "can not create %s\n", argv[1] );
+        return( 1 );
+    }
+
+    /* 1000 silent subframes from a left are 500 frames */
+    SpdifWavWriter_Run( wav, sft_M, 0, 1000 );
+    want += 500;
+    check( want == SpdifWavWriter_Frames( wav ), "run from the left", SpdifWavWriter_Frames( wav ), want );
+
+    /* a lone left, then a run from the right finishes its frame first */
+    SpdifWavWriter_Subframe( wav, sft_M, 0x1230 );
+    SpdifWavWriter_Run( wav, sft_W, 0, 5 );
+    want += 3;
+    check( want == SpdifWavWriter_Frames( wav ), "run from the right", SpdifWavWriter_Frames( wav ), want );
+
+    /* subframes that are not repeated are runs of one */
+    SpdifWavWriter_Run( wav, sft_M, 0x1230, 1 );
+    SpdifWavWriter_Run( wav, sft_W, 0x4560, 1 );
+    want += 1;
+    check( want == SpdifWavWriter_Frames( wav ), "runs of one", SpdifWavWriter_Frames( wav ), want );
+
+    /* a stereo run, then a B run that ends on a left the close pairs up */
+    SpdifWavWriter_Stereo( wav, 0x100, 0x200, 7 );
+    SpdifWavWriter_Run( wav, sft_B, 0, 3 );
+    want += 7 + 1;
+    check( want == SpdifWavWriter_Frames( wav ), "run from a B", SpdifWavWriter_Frames( wav ), want );
+
+    if ( 0 != SpdifWavWriter_Close( wav ) )
+    {
+        fprintf( stderr, "writing %s failed\n", argv[1] );
+        return( 1 );
+    }
+    want += 1;
+
+    frames = wav_frames( argv[1] );
+    check( frames == (long long) want, "frames in the data chunk", (unsigned long long) frames, want );
+
+    return( failures ? 1 : 0 );
+}
@@ -0,0 +1,1485 @@
+/*
+
+  GPL LICENSE SUMMARY
+
+  Copyright(c) Pat Brouillette. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of version 2 of the GNU General Public License as
+  published by the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+  The full GNU General Public License is included in this distribution
+  in the file called LICENSE.GPL.
+
+  Contact Information:
+    Pat Brouillette  pfrench@acm.org
+
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "spdifCapture.h"
+#include "spdifDecoder.h"
+
+/* smallest share of a CSV file worth a thread of its own */
+#define SPDIF_CSV_MIN_PIECE         (1<<22)
+
+/* ticks per second when a file's times are in seconds, or finer than this, and no rate is asked for */
+#define SPDIF_CAPTURE_DEFAULT_RATE  1000000000ULL
+
+/* a file mapped into memory, or stdin read into memory */
+struct spdifMap
+{
+    const char         *data;
+    size_t              size;
+    std::vector<char>   copy;
+#ifdef _WIN32
+    HANDLE              file;
+    HANDLE              mapping;
+#else
+    int                 fd;
+#endif
+};
+
+static int map_Open( struct spdifMap *m, const char *path )
+{
+    m->data = NULL;
+    m->size = 0;
+
+    if ( NULL == path )
+    {
+        char        buf[1<<16];
+        size_t      n;
+
+        while ( 0 != (n = fread( buf, 1, sizeof(buf), stdin )) )
+            m->copy.insert( m->copy.end(), buf, buf + n );
+
+        if ( ferror( stdin ) )
+            return(-1);
+
+        m->data = m->copy.empty() ? "" : &m->copy[0];
+        m->size = m->copy.size();
+        return(0);
+    }
+
+#ifdef _WIN32
+    LARGE_INTEGER   size;
+
+    m->mapping = NULL;
+    m->file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if ( INVALID_HANDLE_VALUE == m->file )
+        return(-1);
+
+    if ( !GetFileSizeEx( m->file, &size ) )
+        return(-1);
+
+    m->size = (size_t) size.QuadPart;
+    m->data = "";
+
+    if ( 0 != m->size )
+    {
+        if ( NULL == (m->mapping = CreateFileMappingA( m->file, NULL, PAGE_READONLY, 0, 0, NULL )) )
+            return(-1);
+
+        if ( NULL == (m->data = (const char *) MapViewOfFile( m->mapping, FILE_MAP_READ, 0, 0, 0 )) )
+            return(-1);
+    }
+#else
+    struct stat     st;
+
+    if ( (m->fd = open( path, O_RDONLY )) < 0 )
+        return(-1);
+
+    if ( 0 != fstat( m->fd, &st ) )
+        return(-1);
+
+    m->size = (size_t) st.st_size;
+    m->data = "";
+
+    if ( 0 != m->size )
+    {
+        void   *p = mmap( NULL, m->size, PROT_READ, MAP_PRIVATE, m->fd, 0 );
+
+        if ( MAP_FAILED == p )
+        {
+            m->size = 0;
+            return(-1);
+        }
+
+        madvise( p, m->size, MADV_SEQUENTIAL );
+        m->data = (const char *) p;
+    }
+#endif
+
+    return(0);
+}
+
+static void map_Close( struct spdifMap *m, const char *path )
+{
+    if ( NULL == path )
+        return;
+
+#ifdef _WIN32
+    if ( (NULL != m->data) && (0 != m->size) )
+        UnmapViewOfFile( m->data );
+    if ( NULL != m->mapping )
+        CloseHandle( m->mapping );
+    if ( INVALID_HANDLE_VALUE != m->file )
+        CloseHandle( m->file );
+#else
+    if ( (NULL != m->data) && (0 != m->size) )
+        munmap( (void *) m->data, m->size );
+    if ( m->fd >= 0 )
+        close( m->fd );
+#endif
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* Numbers */
+/* -------------------------------------------------------------------------------------------- */
+
+static inline int is_digit( char c )
+{
+    return( (unsigned char)(c - '0') < 10 );
+}
+
+/*
+ *  Eight ASCII digits, less '0' each, as loaded little endian into d, to
+ *  their value: pairs, then fours, then all eight in three multiplies.
+ */
+static inline uint64_t digits8( uint64_t d )
+{
+    d = (d * 10) + (d >> 8);
+    d = (((d & 0x000000ff000000ffULL) * (100 + (1000000ULL << 32))) +
+         (((d >> 16) & 0x000000ff000000ffULL) * (1 + (10000ULL << 32)))) >> 32;
+
+    return(d);
+}
+
+/* the digits at p, up to end, into *v; returns where they stop */
+static inline const char *parse_u64( const char *p, const char *end, uint64_t *v )
+{
+    uint64_t    x = 0;
+
+    /* eight at a time while there are eight */
+    while ( end - p >= 8 )
+    {
+        uint64_t    w;
+        uint64_t    d;
+
+        memcpy( &w, p, 8 );
+        d = w - 0x3030303030303030ULL;
+
+        if ( (d | (w + 0x4646464646464646ULL)) & 0x8080808080808080ULL )
+            break;
+
+        x = (x * 100000000ULL) + digits8( d );
+        p += 8;
+    }
+
+    while ( (p < end) && is_digit( *p ) )
+        x = (x * 10) + (uint64_t)(*p++ - '0');
+
+    *v = x;
+    return(p);
+}
+
+/* how times are written in a file, and the ticks they are read into */
+struct spdifTimeFormat
+{
+    int         seconds;    /* else whole ticks */
+    uint64_t    rate;       /* ticks per second */
+};
+
+/*
+ *  A time at p into *t.  Seconds are read as fixed point to the nanosecond,
+ *  an exponent falls back to strtod().  Returns p if there is no number.
+ */
+static const char *parse_time( const char *p, const char *end, const struct spdifTimeFormat *tf, uint64_t *t )
+{
+    static const uint64_t   pow10[10] =
+    {
+        1000000000ULL, 100000000ULL, 10000000ULL, 1000000ULL, 100000ULL,
+        10000ULL, 1000ULL, 100ULL, 10ULL, 1ULL
+    };
+    const char  *q;
+    const char  *f;
+    uint64_t     whole;
+    uint64_t     frac = 0;
+
+    q = parse_u64( p, end, &whole );
+
+    if ( ! tf->seconds )
+    {
+        *t = whole;
+        return(q);
+    }
+
+    if ( (q < end) && ('.' == *q) )
+    {
+        f = ++q;
+        q = parse_u64( f, (end - f > 9) ? (f + 9) : end, &frac );
+        frac *= pow10[q - f];
+
+        /* past the nanosecond */
+        while ( (q < end) && is_digit( *q ) )
+            q++;
+    }
+    else if ( q == p )
+    {
+        return(p);
+    }
+
+    if ( (q < end) && (('e' == *q) || ('E' == *q)) )
+    {
+        char    num[64];
+        size_t  n = 0;
+
+        while ( (p + n < end) && (n < sizeof(num) - 1) && ('\0' != p[n]) && (NULL != strchr( "0123456789.eE+-", p[n] )) )
+            n++;
+
+        memcpy( num, p, n );
+        num[n] = '\0';
+
+        *t = (uint64_t)( strtod( num, NULL ) * (double) tf->rate + 0.5 );
+        return(p + n);
+    }
+
+    *t = (whole * tf->rate) + ((frac * tf->rate + 500000000ULL) / 1000000000ULL);
+    return(q);
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* CSV */
+/* -------------------------------------------------------------------------------------------- */
+
+/*
+ *  A share of a CSV file, read on a thread of its own.  Its first line is
+ *  kept apart, whether it is an edge depends on the level the share before
+ *  ends with.  The widths between the edges after it are the decoder's
+ *  already, clips are noted by where they are in dt.
+ */
+struct spdifCsvPiece
+{
+    const char             *from;
+    const char             *to;
+
+    int                     any;            /* a line was read */
+    const char             *first_line;
+    uint64_t                first_time;
+    int                     first_level;
+    int                     last_level;
+    uint64_t                last_time;
+
+    uint64_t                nedges;         /* edges after the first line */
+    uint64_t                first_edge;
+    uint64_t                last_edge;
+    std::vector<uint16_t>   dt;             /* widths of the edges after first_edge */
+    std::vector<size_t>     clip_at;
+    std::vector<uint64_t>   clip_lost;
+
+    const char             *bad;            /* the line reading stopped at, and why */
+    const char             *why;
+};
+
+/* a CSV line that can not be read, and the line number it has in the file */
+static int csv_Error( const struct spdifMap *m, const char *path, const char *line, const char *why )
+{
+    uint64_t    n = 1;
+
+    for ( const char *p = m->data; NULL != (p = (const char *) memchr( p, '\n', line - p )); p++ )
+        n++;
+
+    fprintf( stderr, "spdif_decode: \"%s\" line %llu: %s\n", path ? path : "stdin", (unsigned long long) n, why );
+    return(-1);
+}
+
+/* past spaces, tabs and quotes */
+static inline const char *csv_Skip( const char *p, const char *eol )
+{
+    while ( (p < eol) && ((' ' == *p) || ('\t' == *p) || ('"' == *p) || ('\r' == *p)) )
+        p++;
+    return(p);
+}
+
+static void csv_Piece(
+    struct spdifCsvPiece            *k,
+    const struct spdifTimeFormat    *tf,
+    unsigned int                     column )
+{
+    const char     *p = k->from;
+    const char     *end = k->to;
+    int             level = 0;
+    uint64_t        prev = 0;
+
+    k->dt.reserve( (end - p) / 16 );
+
+    while ( p < end )
+    {
+        const char     *eol = (const char *) memchr( p, '\n', end - p );
+        const char     *q;
+        uint64_t        t;
+        unsigned int    c;
+        int             bit;
+
+        if ( NULL == eol )
+            eol = end;
+
+        /* blank lines, the last one often is */
+        if ( csv_Skip( p, eol ) == eol )
+        {
+            p = eol + 1;
+            continue;
+        }
+
+        q = parse_time( p, eol, tf, &t );
+        if ( q == p )
+        {
+            k->why = "not a time";
+            break;
+        }
+
+        q = csv_Skip( q, eol );
+        if ( (q < eol) && (',' != *q) )
+        {
+            k->why = "junk after the time";
+            break;
+        }
+
+        if ( k->any && (t < prev) )
+        {
+            k->why = "the time goes backwards";
+            break;
+        }
+
+        /* over to the column */
+        for ( c = 0; (c < column) && (NULL != q); c++ )
+        {
+            if ( NULL != (q = (const char *) memchr( q, ',', eol - q )) )
+                q++;
+        }
+
+        if ( NULL == q )
+        {
+            k->why = "no level in the signal's column";
+            break;
+        }
+
+        q = csv_Skip( q, eol );
+        if ( (q >= eol) || !is_digit( *q ) )
+        {
+            k->why = "no level in the signal's column";
+            break;
+        }
+
+        bit = ('0' != *q);
+
+        for ( q++; (q < eol) && is_digit( *q ); q++ )
+            ;
+        q = csv_Skip( q, eol );
+        if ( (q < eol) && (',' != *q) )
+        {
+            k->why = "junk after the level";
+            break;
+        }
+
+        if ( ! k->any )
+        {
+            k->any = 1;
+            k->first_line = p;
+            k->first_time = t;
+            k->first_level = bit;
+        }
+        else if ( bit != level )
+        {
+            if ( 0 == k->nedges )
+            {
+                k->first_edge = t;
+            }
+            else
+            {
+                uint64_t    w = t - k->last_edge;
+
+                if ( w > 0xffff )
+                {
+                    k->clip_at.push_back( k->dt.size() );
+                    k->clip_lost.push_back( w - 0xffff );
+                    w = 0xffff;
+                }
+
+                k->dt.push_back( (uint16_t) w );
+            }
+
+            k->last_edge = t;
+            k->nedges++;
+        }
+
+        level = bit;
+        prev = t;
+        p = eol + 1;
+    }
+
+    if ( NULL != k->why )
+        k->bad = p;
+
+    k->last_level = level;
+    k->last_time = prev;
+}
+
+/* add a piece's edges after the one at cap's time last */
+static void csv_Append( struct spdifCapture *cap, const struct spdifCsvPiece *k )
+{
+    size_t      from = 0;
+    size_t      c,e;
+
+    cap->dt.insert( cap->dt.end(), k->dt.begin(), k->dt.end() );
+
+    for ( c = 0; c <= k->clip_at.size(); c++ )
+    {
+        size_t      to = (c < k->clip_at.size()) ? (k->clip_at[c] + 1) : k->dt.size();
+        uint64_t    sum = 0;
+
+        for ( e = from; e < to; e++ )
+            sum += k->dt[e];
+
+        cap->t += sum;
+        from = to;
+
+        if ( c < k->clip_at.size() )
+        {
+            cap->lost += k->clip_lost[c];
+
+            spdifClip   clip = { cap->t, cap->lost };
+            cap->clips.push_back( clip );
+        }
+    }
+}
+
+/* split "a, b,c" into trimmed fields */
+static void csv_Fields( const char *p, const char *eol, std::vector<std::string> *fields )
+{
+    while ( p <= eol )
+    {
+        const char *comma = (const char *) memchr( p, ',', eol - p );
+        const char *f_end = comma ? comma : eol;
+
+        while ( (p < f_end) && ((' ' == *p) || ('"' == *p)) )
+            p++;
+        while ( (f_end > p) && ((' ' == f_end[-1]) || ('"' == f_end[-1]) || ('\r' == f_end[-1])) )
+            f_end--;
+
+        fields->push_back( std::string( p, f_end - p ) );
+
+        if ( NULL == comma )
+            break;
+        p = comma + 1;
+    }
+}
+
+static int read_csv(
+    struct spdifCapture             *cap,
+    const struct spdifMap           *m,
+    const char                      *path,
+    const struct spdifReadOptions   *ro )
+{
+    const char             *p = m->data;
+    const char             *end = m->data + m->size;
+    const char             *eol;
+    struct spdifTimeFormat  tf;
+    unsigned int            column = 1;
+    unsigned int            nthreads = ro->nthreads;
+    size_t                  npieces,i;
+    int                     started = 0;
+    int                     level = 0;
+    uint64_t                last = 0;
+    uint64_t                last_line = 0;
+
+    /* a header names the columns */
+    eol = (const char *) memchr( p, '\n', end - p );
+    if ( NULL == eol )
+        eol = end;
+
+    if ( (p < eol) && !is_digit( *p ) && ('.' != *p) )
+    {
+        std::vector<std::string>    fields;
+
+        csv_Fields( p, eol, &fields );
+
+        if ( NULL != ro->signal )
+        {
+            for ( column = 1; column < fields.size(); column++ )
+            {
+                if ( fields[column] == ro->signal )
+                    break;
+            }
+
+            if ( column >= fields.size() )
+            {
+                fprintf( stderr, "spdif_decode: no column \"%s\" in the CSV header\n", ro->signal );
+                return(-1);
+            }
+        }
+
+        p = (eol < end) ? (eol + 1) : end;
+        eol = (const char *) memchr( p, '\n', end - p );
+        if ( NULL == eol )
+            eol = end;
+    }
+
+    /* times in seconds have a point or an exponent */
+    tf.seconds = 0;
+    for ( const char *q = p; (q < eol) && (',' != *q); q++ )
+    {
+        if ( ('.' == *q) || ('e' == *q) || ('E' == *q) )
+            tf.seconds = 1;
+    }
+
+    tf.rate = ro->rate;
+    if ( 0 == tf.rate )
+        tf.rate = tf.seconds ? SPDIF_CAPTURE_DEFAULT_RATE : 0;
+    cap->rate = tf.rate;
+
+    if ( ! tf.seconds )
+        tf.rate = 1;
+
+    cap->format = tf.seconds ? "CSV, times in seconds" : "CSV, times in samples";
+
+    /* shares that start on a line */
+    if ( 0 == nthreads )
+        nthreads = std::thread::hardware_concurrency();
+    if ( 0 == nthreads )
+        nthreads = 1;
+
+    npieces = (size_t)(end - p) / SPDIF_CSV_MIN_PIECE;
+    if ( npieces > nthreads )
+        npieces = nthreads;
+    if ( npieces < 1 )
+        npieces = 1;
+
+    std::vector<spdifCsvPiece>  pieces( npieces );
+    std::vector<std::thread>    pool;
+
+    for ( i = 0; i < npieces; i++ )
+    {
+        const char     *from = p + (i * (size_t)(end - p) / npieces);
+
+        if ( i > 0 )
+        {
+            from = (const char *) memchr( from, '\n', end - from );
+            from = from ? (from + 1) : end;
+            if ( from < pieces[i - 1].from )
+                from = pieces[i - 1].from;
+            pieces[i - 1].to = from;
+        }
+
+        pieces[i].from = from;
+        pieces[i].any = 0;
+        pieces[i].nedges = 0;
+        pieces[i].bad = NULL;
+        pieces[i].why = NULL;
+    }
+    pieces[npieces - 1].to = end;
+
+    for ( i = 1; i < npieces; i++ )
+        pool.push_back( std::thread( csv_Piece, &pieces[i], &tf, column ) );
+
+    csv_Piece( &pieces[0], &tf, column );
+
+    for ( i = 0; i < pool.size(); i++ )
+        pool[i].join();
+
+    /* join them up */
+    for ( i = 0; i < npieces; i++ )
+    {
+        struct spdifCsvPiece   *k = &pieces[i];
+
+        /* the lines are read in order, so is the first one that is wrong */
+        if ( started && k->any && (k->first_time < last_line) )
+            return( csv_Error( m, path, k->first_line, "the time goes backwards" ) );
+
+        if ( ! k->any )
+        {
+            if ( NULL != k->bad )
+                return( csv_Error( m, path, k->bad, k->why ) );
+            continue;
+        }
+
+        if ( ! started )
+        {
+            /* the first line sets the level, edges are timed from it */
+            started = 1;
+            cap->origin = k->first_time;
+            cap->level = (unsigned int) k->first_level;
+            last = k->first_time;
+            level = k->first_level;
+        }
+        else if ( k->first_level != level )
+        {
+            capture_AddEdge( cap, k->first_time - last );
+            last = k->first_time;
+        }
+
+        if ( 0 != k->nedges )
+        {
+            capture_AddEdge( cap, k->first_edge - last );
+            csv_Append( cap, k );
+            last = k->last_edge;
+        }
+
+        if ( NULL != k->bad )
+            return( csv_Error( m, path, k->bad, k->why ) );
+
+        level = k->last_level;
+        last_line = k->last_time;
+    }
+
+    return(0);
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* VCD */
+/* -------------------------------------------------------------------------------------------- */
+
+static inline int is_space( char c )
+{
+    return( (' ' == c) || ('\n' == c) || ('\r' == c) || ('\t' == c) );
+}
+
+/* the next whitespace separated token, false at the end */
+static inline bool next_token( const char **p, const char *end, const char **tok, size_t *len )
+{
+    const char *q = *p;
+
+    while ( (q < end) && is_space( *q ) )
+        q++;
+
+    if ( q >= end )
+        return(false);
+
+    *tok = q;
+    while ( (q < end) && !is_space( *q ) )
+        q++;
+
+    *len = q - *tok;
+    *p = q;
+    return(true);
+}
+
+static inline bool token_is( const char *tok, size_t len, const char *s )
+{
+    return( (strlen( s ) == len) && (0 == memcmp( tok, s, len )) );
+}
+
+/*
+ *  The one bit signal asked for, or the first, and its value changes.  Times
+ *  are in $timescale units, which are turned into ticks; when no rate is asked
+ *  for the ticks are the units, up to a nanosecond.
+ */
+static int read_vcd(
+    struct spdifCapture             *cap,
+    const struct spdifMap           *m,
+    const struct spdifReadOptions   *ro )
+{
+    const char     *p = m->data;
+    const char     *end = m->data + m->size;
+    const char     *tok;
+    size_t          len;
+    std::string     id;
+    std::string     timescale;
+    uint64_t        unit_rate = 1000000000ULL;  /* time units per second, the default is 1 ns */
+    uint64_t        unit_mult = 1;
+    uint64_t        mul = 1;
+    uint64_t        div = 1;
+    uint64_t        now = 0;
+    uint64_t        last = 0;
+    int             level = -1;
+
+    cap->format = "VCD";
+
+    /* declarations */
+    while ( next_token( &p, end, &tok, &len ) )
+    {
+        if ( token_is( tok, len, "$enddefinitions" ) )
+        {
+            while ( next_token( &p, end, &tok, &len ) && !token_is( tok, len, "$end" ) )
+                ;
+            break;
+        }
+        else if ( token_is( tok, len, "$timescale" ) )
+        {
+            while ( next_token( &p, end, &tok, &len ) && !token_is( tok, len, "$end" ) )
+                timescale.append( tok, len );
+        }
+        else if ( token_is( tok, len, "$var" ) )
+        {
+            std::vector<std::string>    words;
+
+            while ( next_token( &p, end, &tok, &len ) && !token_is( tok, len, "$end" ) )
+                words.push_back( std::string( tok, len ) );
+
+            /* type size id reference */
+            if ( id.empty() && (words.size() >= 4) && (words[1] == "1") &&
+                 ((NULL == ro->signal) || (words[3] == ro->signal)) )
+                id = words[2];
+        }
+        else if ( ('$' == tok[0]) )
+        {
+            /* $date, $comment, $scope and the like */
+            while ( next_token( &p, end, &tok, &len ) && !token_is( tok, len, "$end" ) )
+                ;
+        }
+    }
+
+    if ( id.empty() )
+    {
+        if ( NULL != ro->signal )
+            fprintf( stderr, "spdif_decode: no one bit signal \"%s\" in the VCD\n", ro->signal );
+        else
+            fprintf( stderr, "spdif_decode: no one bit signal in the VCD\n" );
+        return(-1);
+    }
+
+    if ( !timescale.empty() )
+    {
+        static const struct { const char *unit; uint64_t rate; } units[] =
+        {
+            { "fs", 1000000000000000ULL }, { "ps", 1000000000000ULL }, { "ns", 1000000000ULL },
+            { "us", 1000000ULL }, { "ms", 1000ULL }, { "s", 1ULL }
+        };
+        char       *u;
+        size_t      i;
+
+        unit_mult = strtoull( timescale.c_str(), &u, 10 );
+        if ( 0 == unit_mult )
+            unit_mult = 1;
+
+        for ( i = 0; i < sizeof(units)/sizeof(units[0]); i++ )
+        {
+            if ( 0 == strcmp( u, units[i].unit ) )
+                break;
+        }
+
+        if ( i == sizeof(units)/sizeof(units[0]) )
+        {
+            fprintf( stderr, "spdif_decode: can not read $timescale \"%s\"\n", timescale.c_str() );
+            return(-1);
+        }
+
+        unit_rate = units[i].rate;
+    }
+
+    /* ticks = units * unit_mult * rate / unit_rate, reduced to ticks = units * mul / div */
+    cap->rate = ro->rate;
+    if ( 0 == cap->rate )
+    {
+        cap->rate = ((unit_rate % unit_mult) || (unit_rate / unit_mult > SPDIF_CAPTURE_DEFAULT_RATE)) ?
+                    SPDIF_CAPTURE_DEFAULT_RATE : (unit_rate / unit_mult);
+    }
+
+    mul = unit_mult * cap->rate;
+    div = unit_rate;
+    for ( uint64_t a = mul, b = div; ; )
+    {
+        uint64_t    r = a % b;
+
+        if ( 0 == r )
+        {
+            mul /= b;
+            div /= b;
+            break;
+        }
+        a = b;
+        b = r;
+    }
+
+    /* value changes */
+    while ( next_token( &p, end, &tok, &len ) )
+    {
+        const char     *ref;
+        size_t          ref_len;
+        int             bit;
+
+        switch ( tok[0] )
+        {
+            case '#':
+                parse_u64( tok + 1, tok + len, &now );
+                if ( 1 != div )
+                    now = (1 == mul) ? ((now + (div >> 1)) / div) : (uint64_t)((double) now * mul / div + 0.5);
+                else
+                    now *= mul;
+                continue;
+
+            case '0': case '1': case 'x': case 'X': case 'z': case 'Z':
+                bit = tok[0];
+                ref = tok + 1;
+                ref_len = len - 1;
+                break;
+
+            case 'b': case 'B':
+                /* a vector, its last bit */
+                bit = tok[len - 1];
+                if ( ! next_token( &p, end, &ref, &ref_len ) )
+                    continue;
+                break;
+
+            case 'r': case 'R':
+                next_token( &p, end, &ref, &ref_len );
+                continue;
+
+            default:
+                /* $dumpvars, $end and the like */
+                continue;
+        }
+
+        if ( (ref_len != id.size()) || (0 != memcmp( ref, id.data(), ref_len )) )
+            continue;
+
+        if ( ('0' != bit) && ('1' != bit) )
+            continue;
+
+        bit = ('1' == bit);
+
+        if ( level < 0 )
+        {
+            /* the first value sets the level, edges are timed from it */
+            cap->origin = now;
+            cap->level = (unsigned int) bit;
+            last = now;
+        }
+        else if ( bit != level )
+        {
+            capture_AddEdge( cap, (now > last) ? (now - last) : 0 );
+            last = now;
+        }
+
+        level = bit;
+    }
+
+    return(0);
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* Logic 2 binary */
+/* -------------------------------------------------------------------------------------------- */
+
+/*
+ *  A Logic 2 binary export of a digital channel:
+ *
+ *    char      identifier[8]   "<SALEAE>"
+ *    int32     version         0
+ *    int32     type            0, digital
+ *    uint32    initial_state
+ *    double    begin_time
+ *    double    end_time
+ *    uint64    num_transitions
+ *    double    transition_times[num_transitions]
+ *
+ *  all little endian, times in seconds.
+ */
+#define SALEAE_BIN_IDENTIFIER       "<SALEAE>"
+#define SALEAE_BIN_HEADER_BYTES     44
+
+/* smallest share of the transitions worth a thread of its own */
+#define SPDIF_BIN_MIN_SHARE         (1<<20)
+
+struct spdifBinShare
+{
+    size_t                  from;           /* transitions */
+    size_t                  to;
+    uint64_t                sum;            /* of the widths */
+    std::vector<uint64_t>   clip_t;         /* sum up to and including a clipped edge */
+    std::vector<uint64_t>   clip_lost;
+    size_t                  bad;            /* first transition not after the one before, or to */
+};
+
+static inline double bin_Time( const char *times, size_t i )
+{
+    double      t;
+
+    memcpy( &t, times + (i << 3), sizeof(t) );
+    return(t);
+}
+
+static inline uint64_t bin_Tick( double t, double begin, double rate )
+{
+    double      x = ((t - begin) * rate) + 0.5;
+
+    return( (x > 0) ? (uint64_t) x : 0 );
+}
+
+/*
+ *  The widths of a share's transitions, straight from the mapped times into
+ *  dt.  Each time must be after the one before it and the first no earlier
+ *  than begin_time; the share stops at the first that is not, NaN included.
+ */
+static void bin_Share(
+    struct spdifBinShare    *k,
+    const char              *times,
+    double                   begin,
+    double                   rate,
+    uint16_t                *dt )
+{
+    double      prev_time = k->from ? bin_Time( times, k->from - 1 ) : begin;
+    uint64_t    prev = k->from ? bin_Tick( prev_time, begin, rate ) : 0;
+    uint64_t    sum = 0;
+    size_t      i;
+
+    k->bad = k->to;
+
+    for ( i = k->from; i < k->to; i++ )
+    {
+        double      t = bin_Time( times, i );
+
+        if ( !((t > prev_time) || ((0 == i) && (t == begin))) )
+        {
+            k->bad = i;
+            break;
+        }
+
+        uint64_t    tick = bin_Tick( t, begin, rate );
+        uint64_t    w = (tick > prev) ? (tick - prev) : 0;
+
+        prev_time = t;
+        prev = tick;
+
+        if ( w > 0xffff )
+        {
+            k->clip_t.push_back( sum + 0xffff );
+            k->clip_lost.push_back( w - 0xffff );
+            w = 0xffff;
+        }
+
+        dt[i] = (uint16_t) w;
+        sum += w;
+    }
+
+    k->sum = sum;
+}
+
+/* times are read at the rate asked for, or to the nanosecond, from the start of the capture */
+static int read_bin(
+    struct spdifCapture             *cap,
+    const struct spdifMap           *m,
+    const struct spdifReadOptions   *ro )
+{
+    const char     *p = m->data;
+    int32_t         version;
+    int32_t         type;
+    uint32_t        initial;
+    double          begin;
+    uint64_t        n;
+    unsigned int    nthreads = ro->nthreads;
+    size_t          nshares,i,c;
+
+    cap->format = "Logic 2 binary";
+
+    if ( m->size < SALEAE_BIN_HEADER_BYTES )
+    {
+        fprintf( stderr, "spdif_decode: Logic 2 binary file is too short\n" );
+        return(-1);
+    }
+
+    memcpy( &version, p + 8, sizeof(version) );
+    memcpy( &type, p + 12, sizeof(type) );
+    memcpy( &initial, p + 16, sizeof(initial) );
+    memcpy( &begin, p + 20, sizeof(begin) );
+    memcpy( &n, p + 36, sizeof(n) );
+
+    if ( (0 != version) || (0 != type) )
+    {
+        fprintf( stderr, "spdif_decode: only version 0 digital Logic 2 binary files can be read, not version %d type %d\n",
+                 (int) version, (int) type );
+        return(-1);
+    }
+
+    if ( n > (m->size - SALEAE_BIN_HEADER_BYTES) / sizeof(double) )
+    {
+        fprintf( stderr, "spdif_decode: Logic 2 binary file is cut short, %llu transitions do not fit\n",
+                 (unsigned long long) n );
+        return(-1);
+    }
+
+    cap->rate = ro->rate ? ro->rate : SPDIF_CAPTURE_DEFAULT_RATE;
+    cap->level = initial ? 1 : 0;
+
+    if ( 0 == nthreads )
+        nthreads = std::thread::hardware_concurrency();
+    if ( 0 == nthreads )
+        nthreads = 1;
+
+    nshares = (size_t)( n / SPDIF_BIN_MIN_SHARE );
+    if ( nshares > nthreads )
+        nshares = nthreads;
+    if ( nshares < 1 )
+        nshares = 1;
+
+    std::vector<spdifBinShare>  shares( nshares );
+    std::vector<std::thread>    pool;
+
+    cap->dt.resize( (size_t) n );
+
+    for ( i = 0; i < nshares; i++ )
+    {
+        shares[i].from = (size_t)( i * n / nshares );
+        shares[i].to = (size_t)( (i + 1) * n / nshares );
+    }
+
+    for ( i = 1; i < nshares; i++ )
+        pool.push_back( std::thread( bin_Share, &shares[i], p + SALEAE_BIN_HEADER_BYTES,
+                                     begin, (double) cap->rate, n ? &cap->dt[0] : NULL ) );
+
+    bin_Share( &shares[0], p + SALEAE_BIN_HEADER_BYTES, begin, (double) cap->rate, n ? &cap->dt[0] : NULL );
+
+    for ( i = 0; i < pool.size(); i++ )
+        pool[i].join();
+
+    /* the shares are in order, so is the first transition that is wrong */
+    for ( i = 0; i < nshares; i++ )
+    {
+        if ( shares[i].bad < shares[i].to )
+        {
+            size_t  bad = shares[i].bad;
+
+            fprintf( stderr, "spdif_decode: Logic 2 binary transition %llu at %.9f s is not after %s\n",
+                     (unsigned long long) bad, bin_Time( p + SALEAE_BIN_HEADER_BYTES, bad ),
+                     bad ? "the one before it" : "begin_time" );
+            return(-1);
+        }
+    }
+
+    /* the clips, in decoder time */
+    for ( i = 0; i < nshares; i++ )
+    {
+        for ( c = 0; c < shares[i].clip_t.size(); c++ )
+        {
+            cap->lost += shares[i].clip_lost[c];
+
+            spdifClip   clip = { cap->t + shares[i].clip_t[c], cap->lost };
+            cap->clips.push_back( clip );
+        }
+
+        cap->t += shares[i].sum;
+    }
+
+    return(0);
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* Packed samples */
+/* -------------------------------------------------------------------------------------------- */
+
+/*
+ *  The line sampled at a fixed rate and nothing else, as capture hardware
+ *  built on an FPGA dumps it: 1 bit per sample, the first sample in bit 0 of
+ *  each byte.  Read as little endian 64-bit words, the edges are found a word
+ *  at a time by SpdifBitEdges.
+ */
+
+/* smallest share of the words worth a thread of its own */
+#define SPDIF_PACKED_MIN_SHARE      (1<<16)
+
+/* words turned into edges at a time */
+#define SPDIF_PACKED_BATCH_WORDS    64
+
+struct spdifPackedShare
+{
+    size_t                  from;           /* words */
+    size_t                  to;
+    unsigned int            tail_bits;      /* samples in a part word after to, last share only */
+    uint64_t                nsamples;
+    uint64_t                nedges;
+    uint64_t                head;           /* samples up to the first edge */
+    uint64_t                tail;           /* samples after the last edge */
+    uint64_t                sum;            /* of the widths after the first edge */
+    std::vector<uint16_t>   dt;             /* the widths after the first edge */
+    std::vector<uint64_t>   clip_t;         /* sum up to and including a clipped edge */
+    std::vector<uint64_t>   clip_lost;
+};
+
+static void packed_Widths( struct spdifPackedShare *k, const uint64_t *widths, size_t n )
+{
+    size_t      i = 0;
+    size_t      at = k->dt.size();
+    uint64_t    sum = k->sum;
+
+    if ( 0 == n )
+        return;
+
+    k->nedges += n;
+
+    /* the first edge of the share is measured from the share before, see read_packed() */
+    if ( k->nedges == n )
+    {
+        k->head = widths[0];
+        widths++;
+        n--;
+    }
+
+    k->dt.resize( at + n );
+
+    for ( ; i < n; i++ )
+    {
+        uint64_t    w = widths[i];
+
+        if ( w > 0xffff )
+        {
+            k->clip_t.push_back( sum + 0xffff );
+            k->clip_lost.push_back( w - 0xffff );
+            w = 0xffff;
+        }
+
+        k->dt[at + i] = (uint16_t) w;
+        sum += w;
+    }
+
+    k->sum = sum;
+}
+
+/* the edges of a share's words, measured from the start of the share */
+static void packed_Share( struct spdifPackedShare *k, const uint64_t *words, const char *tail )
+{
+    struct SpdifBitEdges    be;
+    uint64_t                widths[SPDIF_PACKED_BATCH_WORDS * 64 + SBA_EDGES_SLACK];
+    size_t                  i,n;
+
+    be.Reset();
+
+    /* carry on from the last sample of the share before */
+    if ( k->from > 0 )
+    {
+        be.started = 1;
+        be.level = words[k->from - 1] >> 63;
+    }
+
+    for ( i = k->from; i < k->to; i += n )
+    {
+        n = k->to - i;
+        if ( n > SPDIF_PACKED_BATCH_WORDS )
+            n = SPDIF_PACKED_BATCH_WORDS;
+
+        packed_Widths( k, widths, be.Find( words + i, n << 6, widths ) );
+    }
+
+    if ( 0 != k->tail_bits )
+    {
+        uint64_t    w = 0;
+
+        memcpy( &w, tail, (k->tail_bits + 7) >> 3 );
+        packed_Widths( k, widths, be.Find( &w, k->tail_bits, widths ) );
+    }
+
+    k->nsamples = be.sample;
+    k->tail = be.sample - be.edge;
+}
+
+/* every sample is a tick, at the rate asked for */
+static int read_packed(
+    struct spdifCapture             *cap,
+    const struct spdifMap           *m,
+    const struct spdifReadOptions   *ro )
+{
+    const uint64_t *words = (const uint64_t *) m->data;
+    size_t          nwords = m->size >> 3;
+    unsigned int    nthreads = ro->nthreads;
+    uint64_t        carry = 0;
+    size_t          nshares,i,c;
+
+    cap->format = "packed samples";
+    cap->rate = ro->rate;
+    cap->level = m->size ? (*m->data & 1) : 0;
+
+    if ( 0 == nthreads )
+        nthreads = std::thread::hardware_concurrency();
+    if ( 0 == nthreads )
+        nthreads = 1;
+
+    nshares = nwords / SPDIF_PACKED_MIN_SHARE;
+    if ( nshares > nthreads )
+        nshares = nthreads;
+    if ( nshares < 1 )
+        nshares = 1;
+
+    std::vector<spdifPackedShare>   shares( nshares );
+    std::vector<std::thread>        pool;
+
+    for ( i = 0; i < nshares; i++ )
+    {
+        shares[i].from = i * nwords / nshares;
+        shares[i].to = (i + 1) * nwords / nshares;
+        shares[i].tail_bits = 0;
+        shares[i].nedges = 0;
+        shares[i].head = 0;
+        shares[i].sum = 0;
+    }
+
+    shares[nshares - 1].tail_bits = (unsigned int)( (m->size & 7) << 3 );
+
+    for ( i = 1; i < nshares; i++ )
+        pool.push_back( std::thread( packed_Share, &shares[i], words, m->data + (nwords << 3) ) );
+
+    packed_Share( &shares[0], words, m->data + (nwords << 3) );
+
+    for ( i = 0; i < pool.size(); i++ )
+        pool[i].join();
+
+    /* join the shares up, an edge's width may run back over shares with no edges */
+    for ( i = 0; i < nshares; i++ )
+    {
+        struct spdifPackedShare    *k = &shares[i];
+
+        if ( 0 == k->nedges )
+        {
+            carry += k->nsamples;
+            continue;
+        }
+
+        capture_AddEdge( cap, carry + k->head );
+
+        for ( c = 0; c < k->clip_t.size(); c++ )
+        {
+            cap->lost += k->clip_lost[c];
+
+            spdifClip   clip = { cap->t + k->clip_t[c], cap->lost };
+            cap->clips.push_back( clip );
+        }
+
+        cap->dt.insert( cap->dt.end(), k->dt.begin(), k->dt.end() );
+        cap->t += k->sum;
+        carry = k->tail;
+
+        std::vector<uint16_t>().swap( k->dt );
+    }
+
+    return(0);
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* Edge trace */
+/* -------------------------------------------------------------------------------------------- */
+
+static inline uint64_t trace_Get64( const char *p )
+{
+    uint64_t    v = 0;
+    int         i;
+
+    for ( i = 7; i >= 0; i-- )
+        v = (v << 8) | (unsigned char) p[i];
+
+    return(v);
+}
+
+/*
+ *  A trace written by SpdifTraceWriter, see spdif.h.  Each record is checked
+ *  against the edges read up to it.  A trace cut short keeps every whole
+ *  width, a damaged one ends at the last record that checked out.
+ */
+static int read_trace(
+    struct spdifCapture             *cap,
+    const struct spdifMap           *m,
+    const struct spdifReadOptions   *ro )
+{
+    const unsigned char    *p = (const unsigned char *) m->data + SPDIF_TRACE_HEADER_BYTES;
+    const unsigned char    *end = (const unsigned char *) m->data + m->size;
+    uint64_t                version;
+    uint64_t                edges = 0;
+    uint64_t                time = 0;
+
+    /* as things were at the last good record */
+    size_t                  good_edges = 0;
+    size_t                  good_clips = 0;
+    uint64_t                good_t = 0;
+    uint64_t                good_lost = 0;
+
+    cap->format = "edge trace";
+
+    if ( m->size < SPDIF_TRACE_HEADER_BYTES )
+    {
+        fprintf( stderr, "spdif_decode: edge trace is too short\n" );
+        return(-1);
+    }
+
+    version = trace_Get64( m->data + 8 ) & 0xffffffff;
+    if ( SPDIF_TRACE_VERSION != version )
+    {
+        fprintf( stderr, "spdif_decode: only version %d edge traces can be read, not version %u\n",
+                 SPDIF_TRACE_VERSION, (unsigned int) version );
+        return(-1);
+    }
+
+    /* the trace's own rate, unless it did not know one */
+    cap->rate = trace_Get64( m->data + 16 );
+    if ( 0 == cap->rate )
+        cap->rate = ro->rate;
+    cap->origin = trace_Get64( m->data + 24 );
+    cap->level = (unsigned int)( trace_Get64( m->data + 8 ) >> 32 ) & 1;
+
+    /* most widths are a byte each */
+    cap->dt.reserve( (size_t)( end - p ) );
+
+    while ( p < end )
+    {
+        uint64_t    v = *p++;
+
+        if ( 0 == v )
+        {
+            const char *r = (const char *) p - 1;
+
+            if ( (size_t)( (const char *) end - r ) < SPDIF_TRACE_RECORD_BYTES )
+            {
+                p = end;
+                break;
+            }
+
+            if ( ((0 != memcmp( r, SPDIF_TRACE_SYNC, 4 )) && (0 != memcmp( r, SPDIF_TRACE_END, 4 ))) ||
+                 (trace_Get64( r + 4 ) != edges) || (trace_Get64( r + 12 ) != time) )
+                break;
+
+            good_edges = cap->dt.size();
+            good_clips = cap->clips.size();
+            good_t = cap->t;
+            good_lost = cap->lost;
+
+            if ( 0 == memcmp( r, SPDIF_TRACE_END, 4 ) )
+                return(0);
+
+            p = (const unsigned char *) r + SPDIF_TRACE_RECORD_BYTES;
+            continue;
+        }
+
+        if ( v >= 0x80 )
+        {
+            unsigned int    shift = 7;
+
+            v &= 0x7f;
+            while ( (p < end) && (*p & 0x80) && (shift < 63) )
+            {
+                v |= (uint64_t)( *p++ & 0x7f ) << shift;
+                shift += 7;
+            }
+
+            if ( p == end )
+                break;
+
+            v |= (uint64_t)( *p++ ) << shift;
+        }
+
+        capture_AddEdge( cap, v - 1 );
+        time += v - 1;
+        edges++;
+    }
+
+    if ( p >= end )
+    {
+        fprintf( stderr, "spdif_decode: edge trace was cut short after %llu edges\n",
+                 (unsigned long long) edges );
+        return(0);
+    }
+
+    fprintf( stderr, "spdif_decode: edge trace is damaged at byte %llu, read up to the sync point before it, %llu edges\n",
+             (unsigned long long)( (const char *) p - 1 - m->data ), (unsigned long long) good_edges );
+
+    cap->dt.resize( good_edges );
+    cap->clips.resize( good_clips );
+    cap->t = good_t;
+    cap->lost = good_lost;
+
+    return(0);
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* Public */
+/* -------------------------------------------------------------------------------------------- */
+
+void capture_Init( struct spdifCapture *cap )
+{
+    cap->dt.clear();
+    cap->clips.clear();
+    cap->t = 0;
+    cap->lost = 0;
+    cap->origin = 0;
+    cap->level = 0;
+    cap->rate = 0;
+    cap->bytes = 0;
+    cap->format = "";
+}
+
+int capture_Read(
+    struct spdifCapture             *cap,
+    const char                      *path,
+    const struct spdifReadOptions   *ro )
+{
+    struct spdifMap     m;
+    const char         *p;
+    int                 err;
+
+    if ( 0 != map_Open( &m, path ) )
+    {
+        fprintf( stderr, "spdif_decode: can not read \"%s\"\n", path ? path : "stdin" );
+        map_Close( &m, path );
+        return(-1);
+    }
+
+    cap->bytes = m.size;
+
+    for ( p = m.data; (p < m.data + m.size) && is_space( *p ); p++ )
+        ;
+
+    if ( ro->packed )
+        err = read_packed( cap, &m, ro );
+    else if ( (m.size >= 8) && (0 == memcmp( m.data, SPDIF_TRACE_MAGIC, 8 )) )
+        err = read_trace( cap, &m, ro );
+    else if ( (m.size >= 8) && (0 == memcmp( m.data, SALEAE_BIN_IDENTIFIER, 8 )) )
+        err = read_bin( cap, &m, ro );
+    else if ( (p < m.data + m.size) && ('$' == *p) )
+        err = read_vcd( cap, &m, ro );
+    else
+        err = read_csv( cap, &m, path, ro );
+
+    map_Close( &m, path );
+
+    return(err);
+}
+
+uint64_t capture_Sample( const struct spdifCapture *cap, uint64_t t )
+{
+    size_t  lo = 0;
+    size_t  hi = cap->clips.size();
+
+    /* first clip after t */
+    while ( lo < hi )
+    {
+        size_t  mid = lo + ((hi - lo) >> 1);
+
+        if ( cap->clips[mid].t <= t )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return( cap->origin + (lo ? (t + cap->clips[lo - 1].lost) : t) );
+}
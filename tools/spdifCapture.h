@@ -0,0 +1,116 @@
+#ifndef SPDIF_CAPTURE_H
+#define SPDIF_CAPTURE_H 1
+/*
+
+  GPL LICENSE SUMMARY
+
+  Copyright(c) Pat Brouillette. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of version 2 of the GNU General Public License as
+  published by the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+  The full GNU General Public License is included in this distribution
+  in the file called LICENSE.GPL.
+
+  Contact Information:
+    Pat Brouillette  pfrench@acm.org
+
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+/*
+ *  Captures read from files for spdif_decode, turned into the edge widths
+ *  the decoder takes.
+ */
+
+/* an edge wider than the decoder's 16-bit widths, and what was cut off it */
+struct spdifClip
+{
+    uint64_t    t;          /* decoder time at the end of the edge */
+    uint64_t    lost;       /* ticks cut off this edge and all before it */
+};
+
+/* a capture as the decoder takes it */
+struct spdifCapture
+{
+    std::vector<uint16_t>   dt;
+    std::vector<spdifClip>  clips;
+    uint64_t                t;          /* decoder time so far */
+    uint64_t                lost;
+    uint64_t                origin;     /* tick the first width is measured from */
+    unsigned int            level;      /* of the line before the first edge */
+    uint64_t                rate;       /* ticks per second, 0 when not known */
+    uint64_t                bytes;      /* read from the file */
+    const char             *format;     /* what the file turned out to be */
+};
+
+struct spdifReadOptions
+{
+    uint64_t        rate;       /* ticks per second to read times in, 0 for the file's own */
+    const char     *signal;     /* CSV column or VCD signal to decode, NULL for the first */
+    unsigned int    nthreads;   /* 0 for one per core */
+    int             packed;     /* raw samples, 1 bit each, not a file of edges */
+};
+
+/* widths of edges are measured in ticks, the first one from tick 0 */
+static inline void capture_AddEdge( struct spdifCapture *cap, uint64_t width )
+{
+    if ( width > 0xffff )
+    {
+        cap->lost += width - 0xffff;
+        width = 0xffff;
+        cap->t += width;
+
+        spdifClip   clip = { cap->t, cap->lost };
+        cap->clips.push_back( clip );
+    }
+    else
+    {
+        cap->t += width;
+    }
+
+    cap->dt.push_back( (uint16_t) width );
+}
+
+void capture_Init( struct spdifCapture *cap );
+
+/*
+ *  Read a capture, NULL for stdin.  Files are mapped rather than read, and
+ *  the kind of file is told from what is in it:
+ *
+ *    edge trace        SpdifTraceWriter output, starts with "SPDIFTRC"
+ *    Logic 2 binary    a digital channel, starts with "<SALEAE>"
+ *    VCD               starts with a $ keyword
+ *    CSV               "sample, level" lines or Logic exports, times in samples
+ *                      or seconds, an optional header naming the columns
+ *
+ *  unless the options say it is packed samples, which can not be told apart
+ *  from anything else:
+ *
+ *    packed samples    the line sampled at the capture rate, 1 bit per sample,
+ *                      the first in bit 0 of each byte
+ *
+ *  Prints what went wrong and returns -1 if it could not be read.
+ */
+int capture_Read(
+    struct spdifCapture             *cap,
+    const char                      *path,
+    const struct spdifReadOptions   *ro );
+
+/* the capture tick a decoder time stands for, putting back what was clipped before it */
+uint64_t capture_Sample( const struct spdifCapture *cap, uint64_t t );
+
+#endif /* SPDIF_CAPTURE_H */
@@ -0,0 +1,545 @@
+/*
+
+  GPL LICENSE SUMMARY
+
+  Copyright(c) Pat Brouillette. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of version 2 of the GNU General Public License as
+  published by the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+  The full GNU General Public License is included in this distribution
+  in the file called LICENSE.GPL.
+
+  Contact Information:
+    Pat Brouillette  pfrench@acm.org
+
+*/
+
+/*
+ *  spdif_decode, the decoder without Logic 2.  Reads a capture, decodes
+ *  all of it on every core with SpdifDecodeParallel() and writes the
+ *  subframes out as raw words, WAV and/or CSV.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "spdif.h"
+#include "spdifCapture.h"
+
+/* stdio buffer for the files written */
+#define SPDIF_IO_BUFFER_BYTES   (1<<20)
+
+struct spdifOptions
+{
+    const char     *in;
+    const char     *raw;
+    const char     *wav;
+    const char     *csv;
+    const char     *trace;
+    const char     *signal;
+    unsigned int    wav_bits;
+    uint32_t        audio_rate;     /* 0 to work it out */
+    uint64_t        capture_rate;   /* 0 when not known, times are then in samples */
+    unsigned int    nthreads;
+    int             packed;
+    int             quiet;
+};
+
+/* the decoded subframes */
+struct spdifResult
+{
+    std::vector<uint64_t>       t_start;
+    std::vector<uint64_t>       t_end;
+    std::vector<unsigned char>  type;
+    std::vector<uint32_t>       raw;
+    std::vector<unsigned char>  flags;
+    struct SpdifSubframeBuffer  buf;
+};
+
+typedef std::chrono::steady_clock   spdifClock;
+
+static double seconds_since( spdifClock::time_point start )
+{
+    return( std::chrono::duration<double>( spdifClock::now() - start ).count() );
+}
+
+static void usage( void )
+{
+    fprintf( stderr,
+        "usage: spdif_decode [options] [capture]\n"
+        "  reads the capture, or stdin:\n"
+        "    CSV, \"sample, level\" lines or a Logic export with times in seconds\n"
+        "    VCD\n"
+        "    Logic 2 binary export of a digital channel\n"
+        "    edge trace, recorded by the plugin or with -t\n"
+        "    packed samples with -p\n"
+        "  -r file    write the raw 32-bit subframes\n"
+        "  -w file    write a WAV file\n"
+        "  -b bits    WAV sample size, 16, 20 or 24 (16)\n"
+        "  -a rate    WAV sample rate, instead of the one in the channel status\n"
+        "  -c file    write the subframes as CSV\n"
+        "  -t file    write the capture's edges as an edge trace\n"
+        "  -s rate    capture sample rate in Hz, times in seconds are read at it\n"
+        "  -n name    the CSV column or VCD signal to decode, else the first\n"
+        "  -j n       decode threads, 0 for one per core (0)\n"
+        "  -p         the capture is raw samples at the -s rate, 1 bit each,\n"
+        "             the first in bit 0 of each byte\n"
+        "  -q         no summary\n" );
+}
+
+static int parse_options( int argc, char *argv[], struct spdifOptions *opt )
+{
+    int         i;
+
+    memset( opt, 0, sizeof(*opt) );
+    opt->wav_bits = SPDIF_WAV_BITS_16;
+
+    for ( i = 1; i < argc; i++ )
+    {
+        const char *arg = argv[i];
+
+        if ( ('-' != arg[0]) || ('\0' == arg[1]) )
+        {
+            if ( NULL != opt->in )
+                return(-1);
+            opt->in = arg;
+            continue;
+        }
+
+        if ( 0 == strcmp( arg, "-q" ) )
+        {
+            opt->quiet = 1;
+            continue;
+        }
+
+        if ( 0 == strcmp( arg, "-p" ) )
+        {
+            opt->packed = 1;
+            continue;
+        }
+
+        /* everything else takes a value */
+        if ( (i + 1 >= argc) || ('\0' != arg[2]) )
+            return(-1);
+
+        const char *val = argv[++i];
+
+        switch ( arg[1] )
+        {
+            case 'r':   opt->raw = val;                                 break;
+            case 'w':   opt->wav = val;                                 break;
+            case 'c':   opt->csv = val;                                 break;
+            case 't':   opt->trace = val;                               break;
+            case 'b':   opt->wav_bits = (unsigned int) atoi( val );     break;
+            case 'a':   opt->audio_rate = (uint32_t) atol( val );       break;
+            case 's':   opt->capture_rate = strtoull( val, NULL, 10 );  break;
+            case 'n':   opt->signal = val;                              break;
+            case 'j':   opt->nthreads = (unsigned int) atoi( val );     break;
+            default:    return(-1);
+        }
+    }
+
+    if ( (SPDIF_WAV_BITS_16 != opt->wav_bits) && (SPDIF_WAV_BITS_20 != opt->wav_bits) &&
+         (SPDIF_WAV_BITS_24 != opt->wav_bits) )
+        return(-1);
+
+    return(0);
+}
+
+/*
+ *  Decode the capture as the plugin does: an edge longer than SPDIF_IDLE_GAP_MS
+ *  ends what came before it, which is decoded on its own, and decoding starts
+ *  over after it.  Without a capture rate the whole capture is one stretch.
+ */
+static void decode_capture( const struct spdifCapture *cap, unsigned int nthreads, struct spdifResult *res )
+{
+    const uint16_t     *dt = &cap->dt[0];
+    size_t              n = cap->dt.size();
+    uint64_t            idle = cap->rate * SPDIF_IDLE_GAP_MS / 1000;
+    uint64_t            t = 0;      /* decoder time at the end of edge e */
+    uint64_t            base = 0;   /* and where the stretch being looked at starts */
+    size_t              from = 0;
+    size_t              c = 0;
+    size_t              e,s;
+
+    for ( e = 0; e <= n; e++ )
+    {
+        uint64_t    width = 0;
+
+        if ( e < n )
+        {
+            width = dt[e];
+            t += width;
+
+            /* what was clipped off a wide edge counts too */
+            if ( 0xffff == width )
+            {
+                while ( (c < cap->clips.size()) && (cap->clips[c].t < t) )
+                    c++;
+                if ( (c < cap->clips.size()) && (cap->clips[c].t == t) )
+                    width += cap->clips[c].lost - (c ? cap->clips[c - 1].lost : 0);
+            }
+
+            if ( (0 == idle) || (width <= idle) )
+                continue;
+        }
+
+        if ( e > from )
+        {
+            struct SpdifSubframeBuffer  part;
+            size_t                      o = res->buf.count;
+
+            part.t_start = res->buf.t_start + o;
+            part.t_end = res->buf.t_end + o;
+            part.type = res->buf.type + o;
+            part.raw = res->buf.raw + o;
+            part.flags = res->buf.flags + o;
+            part.capacity = res->buf.capacity - o;
+            part.count = 0;
+
+            SpdifDecodeParallel( dt + from, e - from, nthreads, (e < n), &part );
+
+            for ( s = 0; s < part.count; s++ )
+            {
+                part.t_start[s] += base;
+                part.t_end[s] += base;
+            }
+            if ( (0 != o) && (0 != part.count) )
+                part.flags[0] |= SPDIF_SF_GAP;
+
+            res->buf.count += part.count;
+        }
+
+        /* the edge that ends the gap is where the decoder starts over */
+        base = t;
+        from = e + 1;
+    }
+}
+
+/* the rate the left channel status of the first whole block gives, 0 if none does */
+static uint32_t status_rate( const struct spdifResult *res )
+{
+    const struct SpdifSubframeBuffer   *b = &res->buf;
+    size_t                              s,i;
+
+    for ( s = 0; s < b->count; s++ )
+    {
+        unsigned char   cs[CHANNEL_STATUS_NBYTES];
+
+        if ( sft_B != b->type[s] )
+            continue;
+
+        if ( b->count - s < 384 )
+            break;
+
+        memset( cs, 0, sizeof(cs) );
+
+        for ( i = 0; i < CHANNEL_STATUS_NBITS; i++ )
+            cs[i >> 3] |= ((b->raw[s + 2*i] >> 30) & 1) << (i & 7);
+
+        return( SpdifChannelStatus_Rate( cs ) );
+    }
+
+    return(0);
+}
+
+static int write_raw( const char *path, const struct spdifResult *res )
+{
+    FILE       *f;
+    int         err = 0;
+
+    if ( NULL == (f = fopen( path, "wb" )) )
+        return(-1);
+
+    if ( res->buf.count != fwrite( res->buf.raw, sizeof(uint32_t), res->buf.count, f ) )
+        err = -1;
+
+    if ( 0 != fclose( f ) )
+        err = -1;
+
+    return(err);
+}
+
+static int write_wav( const char *path, const struct spdifResult *res,
+                      const struct spdifCapture *cap, const struct spdifOptions *opt )
+{
+    const struct SpdifSubframeBuffer   *b = &res->buf;
+    struct SpdifWavWriter              *wav;
+    uint32_t                            rate = opt->audio_rate;
+    size_t                              s;
+
+    if ( 0 == rate )
+        rate = status_rate( res );
+
+    if ( (0 == rate) && (0 != cap->rate) && (0 != b->count) )
+    {
+        uint64_t    ticks = 0;
+
+        for ( s = 0; s < b->count; s++ )
+            ticks += b->t_end[s] - b->t_start[s];
+
+        rate = SpdifNominalRate( b->count, 2 * ticks, (uint32_t) cap->rate );
+    }
+
+    if ( 0 == rate )
+        rate = 48000;
+
+    if ( NULL == (wav = SpdifWavWriter_Open( path, rate, opt->wav_bits )) )
+        return(-1);
+
+    for ( s = 0; s < b->count; s++ )
+        SpdifWavWriter_Subframe( wav, (enum SpdifFrameType) b->type[s], b->raw[s] );
+
+    return( SpdifWavWriter_Close( wav ) );
+}
+
+/* time,type,raw,pcm,flags - the time in seconds with a capture rate, else in samples */
+static int write_csv( const char *path, const struct spdifResult *res,
+                      const struct spdifCapture *cap )
+{
+    static const char                   types[] = { '?', 'B', 'M', 'W' };
+    const struct SpdifSubframeBuffer   *b = &res->buf;
+    FILE                               *f;
+    int                                 err = 0;
+    size_t                              s;
+
+    if ( NULL == (f = fopen( path, "w" )) )
+        return(-1);
+
+    setvbuf( f, NULL, _IOFBF, SPDIF_IO_BUFFER_BYTES );
+
+    fprintf( f, "%s,Type,Raw,PCM,Flags\n", cap->rate ? "Time [s]" : "Sample" );
+
+    for ( s = 0; s < b->count; s++ )
+    {
+        uint64_t    t = capture_Sample( cap, b->t_start[s] );
+        int         pcm = (int16_t)(uint16_t)((b->raw[s] & 0x0ffff000) >> 12);
+
+        if ( cap->rate )
+            fprintf( f, "%.9f,", (double) t / cap->rate );
+        else
+            fprintf( f, "%llu,", (unsigned long long) t );
+
+        fprintf( f, "%c,%08x,%d,%x\n", types[b->type[s] & 3], b->raw[s], pcm, b->flags[s] );
+    }
+
+    if ( ferror( f ) )
+        err = -1;
+
+    if ( 0 != fclose( f ) )
+        err = -1;
+
+    return(err);
+}
+
+/* the widths of a capture as they were, what was clipped off them put back */
+struct spdifWidths
+{
+    const struct spdifCapture  *cap;
+    uint64_t                    t;
+    uint64_t                    lost;
+    size_t                      i;
+    size_t                      c;
+
+    void Start( const struct spdifCapture *from )
+    {
+        cap = from;
+        t = lost = 0;
+        i = c = 0;
+    }
+
+    bool Next( uint64_t *width )
+    {
+        uint64_t    w;
+
+        if ( i == cap->dt.size() )
+            return false;
+
+        w = cap->dt[i++];
+        t += w;
+
+        if ( (c < cap->clips.size()) && (cap->clips[c].t == t) && (0xffff == w) )
+        {
+            w += cap->clips[c].lost - lost;
+            lost = cap->clips[c].lost;
+            c++;
+        }
+
+        *width = w;
+        return true;
+    }
+};
+
+static uint64_t gcd64( uint64_t a, uint64_t b )
+{
+    while ( 0 != b )
+    {
+        uint64_t    r = a % b;
+
+        a = b;
+        b = r;
+    }
+
+    return(a);
+}
+
+/*
+ *  Written at the coarsest rate the capture's times all fit, a Logic export
+ *  in seconds is read in nanoseconds but its edges fall on whole samples, and
+ *  widths in samples mostly take a byte.
+ */
+static int write_trace( const char *path, const struct spdifCapture *cap )
+{
+    struct SpdifTraceWriter    *tw;
+    struct spdifWidths          widths;
+    uint64_t                    div = 0;
+    uint64_t                    w;
+
+    if ( 0 != cap->rate )
+    {
+        div = gcd64( cap->rate, cap->origin );
+
+        widths.Start( cap );
+        while ( (div > 1) && widths.Next( &w ) )
+            div = gcd64( div, w );
+    }
+
+    if ( 0 == div )
+        div = 1;
+
+    if ( NULL == (tw = SpdifTraceWriter_Open( path, cap->rate / div, cap->origin / div, cap->level )) )
+        return(-1);
+
+    widths.Start( cap );
+    while ( widths.Next( &w ) )
+        SpdifTraceWriter_Edge( tw, w / div );
+
+    return( SpdifTraceWriter_Close( tw ) );
+}
+
+int main ( int argc, char *argv[] )
+{
+    struct spdifOptions     opt;
+    struct spdifCapture     cap;
+    struct spdifReadOptions ro;
+    struct spdifResult      res;
+    spdifClock::time_point  start;
+    double                  t_read,t_decode,t_write;
+    uint64_t                nparity = 0, ngap = 0, nrelock = 0, nsuspect = 0, nblocks = 0;
+    size_t                  s,cap_subframes;
+    int                     err = 0;
+
+    if ( 0 != parse_options( argc, argv, &opt ) )
+    {
+        usage();
+        return(2);
+    }
+
+    capture_Init( &cap );
+    ro.rate = opt.capture_rate;
+    ro.signal = opt.signal;
+    ro.nthreads = opt.nthreads;
+    ro.packed = opt.packed;
+
+    start = spdifClock::now();
+    if ( 0 != capture_Read( &cap, opt.in, &ro ) )
+        return(1);
+    t_read = seconds_since( start );
+
+    if ( cap.dt.empty() )
+    {
+        fprintf( stderr, "spdif_decode: no edges in \"%s\", the signal never changes level\n", opt.in ? opt.in : "stdin" );
+        return(1);
+    }
+
+    /* a subframe takes at least 32 edges */
+    cap_subframes = (cap.dt.size() >> 5) + 1;
+    res.t_start.resize( cap_subframes );
+    res.t_end.resize( cap_subframes );
+    res.type.resize( cap_subframes );
+    res.raw.resize( cap_subframes );
+    res.flags.resize( cap_subframes );
+
+    res.buf.t_start = &res.t_start[0];
+    res.buf.t_end = &res.t_end[0];
+    res.buf.type = &res.type[0];
+    res.buf.raw = &res.raw[0];
+    res.buf.flags = &res.flags[0];
+    res.buf.capacity = cap_subframes;
+    res.buf.count = 0;
+
+    start = spdifClock::now();
+    decode_capture( &cap, opt.nthreads, &res );
+    t_decode = seconds_since( start );
+
+    start = spdifClock::now();
+    if ( (NULL != opt.raw) && (0 != write_raw( opt.raw, &res )) )
+    {
+        fprintf( stderr, "spdif_decode: error writing \"%s\"\n", opt.raw );
+        err = 1;
+    }
+    if ( (NULL != opt.wav) && (0 != write_wav( opt.wav, &res, &cap, &opt )) )
+    {
+        fprintf( stderr, "spdif_decode: error writing \"%s\"\n", opt.wav );
+        err = 1;
+    }
+    if ( (NULL != opt.csv) && (0 != write_csv( opt.csv, &res, &cap )) )
+    {
+        fprintf( stderr, "spdif_decode: error writing \"%s\"\n", opt.csv );
+        err = 1;
+    }
+    if ( (NULL != opt.trace) && (0 != write_trace( opt.trace, &cap )) )
+    {
+        fprintf( stderr, "spdif_decode: error writing \"%s\"\n", opt.trace );
+        err = 1;
+    }
+    t_write = seconds_since( start );
+
+    if ( ! opt.quiet )
+    {
+        for ( s = 0; s < res.buf.count; s++ )
+        {
+            nparity += (res.flags[s] & SPDIF_SF_PARITY) ? 1 : 0;
+            ngap += (res.flags[s] & SPDIF_SF_GAP) ? 1 : 0;
+            nrelock += (res.flags[s] & SPDIF_SF_RELOCK) ? 1 : 0;
+            nsuspect += (res.flags[s] & SPDIF_SF_SUSPECT) ? 1 : 0;
+            nblocks += (sft_B == res.type[s]) ? 1 : 0;
+        }
+
+        fprintf( stderr, "%s, ", cap.format );
+        fprintf( stderr, "%llu edges, %llu subframes, %llu blocks, %llu parity errors, %llu gaps, %llu relocks, %llu suspect\n",
+            (unsigned long long) cap.dt.size(), (unsigned long long) res.buf.count,
+            (unsigned long long) nblocks, (unsigned long long) nparity,
+            (unsigned long long) ngap, (unsigned long long) nrelock, (unsigned long long) nsuspect );
+        fprintf( stderr, "read   %8.3f s  %9.1f MB/s  %9.1f Medges/s\n",
+            t_read, cap.bytes / 1e6 / std::max( t_read, 1e-9 ), cap.dt.size() / 1e6 / std::max( t_read, 1e-9 ) );
+        fprintf( stderr, "decode %8.3f s  %9.1f Medges/s  %9.1f Msubframes/s\n",
+            t_decode, cap.dt.size() / 1e6 / std::max( t_decode, 1e-9 ), res.buf.count / 1e6 / std::max( t_decode, 1e-9 ) );
+        fprintf( stderr, "write  %8.3f s\n", t_write );
+    }
+
+    if ( 0 == res.buf.count )
+    {
+        fprintf( stderr, "spdif_decode: no subframes in %llu edges, not S/PDIF or not sampled fast enough\n",
+            (unsigned long long) cap.dt.size() );
+        err = 1;
+    }
+
+    return(err);
+}